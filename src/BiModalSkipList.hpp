@@ -1,11 +1,18 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <random>
 #include <cassert>
+#include <memory>
 #include <memory_resource>
 #include <stdexcept>
+#include <type_traits>
+#include <vector>
 #include "Nodes.hpp"
+#include "PieceTree.hpp"
 
 // 스킵 리스트용 상수들
 constexpr int MAX_LEVEL = 16;
@@ -14,14 +21,26 @@ constexpr double P = 0.25;
 
 class BiModalText {
 public:
-    BiModalText() : head(nullptr), total_size(0) {
+    BiModalText() : BiModalText(std::random_device{}()) {}
+
+    // 시드 지정 생성자: 같은 시드와 같은 편집 순서면 노드 레벨(= 구조와 지연 시간 분포)이 매번 같다.
+    explicit BiModalText(uint64_t seed) : head(nullptr), total_size(0), rng_state(seed) {
         head = create_node(MAX_LEVEL);
-        std::random_device rd;
-        gen = std::mt19937(rd());
-        dist = std::uniform_real_distribution<>(0.0, 1.0);
+    }
+
+    // 벌크 로드 생성자: 큰 버퍼(파일 열기 등)를 한 번에 균형 잡힌 구조로 적재한다.
+    explicit BiModalText(std::string_view s) : BiModalText() {
+        assign(s);
+    }
+
+    BiModalText(std::string_view s, uint64_t seed) : BiModalText(seed) {
+        assign(s);
     }
 
     ~BiModalText() {
+        // 공개본은 읽기 스레드(Reader)가 모두 끝났다는 전제로 바로 해제한다.
+        delete published.load();
+        for (const auto& r : retired) delete r.second;
         clear();
         if (head) {   // 안전 장치
             destroy_node(head);
@@ -43,6 +62,25 @@ public:
 
     // 레벨 0 기준 노드 구조 덤프
     void debug_dump_structure(std::ostream& os = std::cerr) const;
+
+    // 레벨 0 노드 수 / 가장 큰 노드의 논리 크기 (구조 테스트용)
+    size_t debug_node_count() const;
+    size_t debug_max_node_size() const;
+
+    // Compact 가 아닌(Gap/Pending) 노드 수 (모드 정책 테스트용)
+    size_t debug_gap_node_count() const;
+
+    // Gap/Pending 노드 힙 버퍼의 빈 공간(용량 - 논리 크기) 합계 (inline 저장소는 제외)
+    size_t debug_gap_slack() const;
+
+    // Compact 노드 힙 버퍼의 빈 공간(용량 - 논리 크기) 합계 (optimize() 후 남는 메모리 검사용)
+    size_t debug_compact_slack() const;
+
+    // 다음 optimize() 가 정리할 노드 수 (dirty_nodes 크기)
+    size_t debug_dirty_node_count() const { return dirty_nodes.size(); }
+
+    // 지금까지 만든 노드 수 (head 포함, 해제한 노드도 센다)
+    size_t debug_created_nodes() const { return created_nodes; }
     #endif
 
     // --- [Move Up] Iterator Definition & Smart Caching ---
@@ -51,43 +89,26 @@ public:
         size_t offset;
         
         // --- [캐싱 변수] ---
-        enum class Mode { None, Compact, Gap };
-        Mode mode;
-        const char* compact_ptr;
+        // Compact 노드는 gap 이 비어 있으므로 front 하나만, Gap 노드는 front/back 두 덩어리가 된다.
         size_t cached_len;    // 현재 노드의 전체 길이
-        const char* gap_front_ptr;
-        size_t gap_front_len;
-        const char* gap_back_ptr;
-        size_t gap_back_len;
+        const char* front_ptr;
+        size_t front_len;
+        const char* back_ptr;
 
         void update_cache() {
             if (!curr_node) {
-                mode = Mode::None;
-                compact_ptr = nullptr;
                 cached_len = 0;
-                gap_front_ptr = gap_back_ptr = nullptr;
-                gap_front_len = gap_back_len = 0;
+                front_ptr = back_ptr = nullptr;
+                front_len = 0;
                 return;
             }
             
-            // 노드 타입에 따라 길이와 포인터를 미리 가져옴 (std::visit 1회 수행)
-            if (std::holds_alternative<CompactNode>(curr_node->data)) {
-                const auto& c_node = std::get<CompactNode>(curr_node->data);
-                mode = Mode::Compact;
-                compact_ptr = c_node.buf.data();
-                cached_len = c_node.buf.size();
-                gap_front_ptr = gap_back_ptr = nullptr;
-                gap_front_len = gap_back_len = 0;
-            } else { // GapNode fast path
-                const auto& g_node = std::get<GapNode>(curr_node->data);
-                mode = Mode::Gap;
-                cached_len = g_node.size();
-                gap_front_ptr = g_node.buf.data();
-                gap_front_len = g_node.gap_start;
-                gap_back_ptr = g_node.buf.data() + g_node.gap_end;
-                gap_back_len = g_node.buf.size() - g_node.gap_end;
-                compact_ptr = nullptr;
-            }
+            // 노드가 바뀔 때 헤더 필드만 읽어 둔다. (모드 분기 없음)
+            const NodeData& d = curr_node->data;
+            cached_len = d.size();
+            front_ptr = d.buf.data();
+            front_len = d.gap_start;
+            back_ptr = d.buf.data() + d.gap_end;
         }
 
     public:
@@ -97,16 +118,10 @@ public:
 
         char operator*() const {
             if (!curr_node) return '\0';
-            if (mode == Mode::Compact) {
-                return compact_ptr[offset];
-            } else if (mode == Mode::Gap) {
-                if (offset < gap_front_len) {
-                    return gap_front_ptr[offset];
-                }
-                size_t back_offset = offset - gap_front_len;
-                return gap_back_ptr[back_offset];
+            if (offset < front_len) {
+                return front_ptr[offset];
             }
-            return '\0';
+            return back_ptr[offset - front_len];
         }
 
         Iterator& operator++() {
@@ -114,7 +129,7 @@ public:
             
             offset++;
             
-            // [최적화] std::visit 호출 없이 캐싱된 길이와 비교
+            // [최적화] 캐싱된 길이와 비교
             if (offset >= cached_len) {
                 curr_node = curr_node->next[0];
                 offset = 0;
@@ -130,6 +145,132 @@ public:
     
     Iterator begin() const { return Iterator(head->next[0], 0); }
     Iterator end() const { return Iterator(nullptr, 0); }
+
+    // --- Cursor: find_node 경로 캐싱 ---
+    // 같은 자리에서 연속으로 타이핑/삭제할 때 매번 head 에서 find_node 를 다시 타지 않도록
+    // update[]/rank[] 와 대상 노드를 보관한다.
+    // - 캐시는 커서가 대상 노드를 벗어나거나, 다른 경로(BiModalText 직접 호출, 다른 커서)로
+    //   문서가 바뀌면(edit_version 불일치) 무효화되고 다음 접근 때 한 번만 재탐색한다.
+    // - 노드 안에 들어가는 작은 편집은 NodeData::insert/erase + span 증감만으로 끝난다.
+    //   분할/노드 제거가 필요한 편집은 BiModalText::insert/erase 로 넘긴다.
+    // - 위치는 절대 오프셋이며, 다른 곳에서의 편집으로 자동 보정되지 않는다.
+    class Cursor {
+    public:
+        explicit Cursor(BiModalText& text, size_t pos = 0) : txt(&text), pos(pos) {
+            if (pos > text.total_size) throw std::out_of_range("Cursor pos out of range");
+        }
+
+        size_t position() const { return pos; }
+
+        void move_to(size_t new_pos) {
+            if (new_pos > txt->total_size) throw std::out_of_range("Cursor pos out of range");
+            if (cached() && new_pos >= rank[0]) {
+                // 앞쪽 이동은 레벨 0 을 몇 노드만 걸어가 본다. (find_node 의 보정 루프와 동일)
+                node_offset = new_pos - rank[0];
+                int steps = 0;
+                while (node_offset > node->content_size() && node->next[0] && steps++ < WALK_LIMIT) {
+                    advance_node();
+                }
+                if (node_offset > node->content_size()) node = nullptr;
+            } else {
+                node = nullptr;
+            }
+            pos = new_pos;
+        }
+
+        void move_by(std::ptrdiff_t delta) {
+            if (delta < 0 && static_cast<size_t>(-delta) > pos) {
+                throw std::out_of_range("Cursor pos out of range");
+            }
+            move_to(pos + delta);
+        }
+
+        // 커서 위치의 문자
+        char get() {
+            if (pos >= txt->total_size) throw std::out_of_range("Index out of range");
+            sync();
+            while (node_offset >= node->content_size()) advance_node();
+            return node->data.at(node_offset);
+        }
+
+        // 커서 위치에 s 를 삽입하고 커서를 삽입된 텍스트 뒤로 옮긴다.
+        void insert_here(std::string_view s) {
+            if (s.empty()) return;
+            sync();
+            if (!node || node->content_size() + s.size() > NODE_MAX_SIZE) {
+                txt->insert(pos, s);
+                pos += s.size();
+                node = nullptr;
+                return;
+            }
+
+            txt->insert_into_node(node, node_offset, s, update);
+            txt->snapshot_changes.note(pos, 0, s.size());
+            pos += s.size();
+            node_offset += s.size();
+            version = ++txt->edit_version;
+#ifdef BIMODAL_DEBUG
+            txt->debug_verify_spans();
+#endif
+        }
+
+        // 커서 위치부터 len 바이트를 지운다. (커서 위치는 그대로)
+        void erase_here(size_t len) {
+            if (pos >= txt->total_size || len == 0) return;
+            len = std::min(len, txt->total_size - pos);
+            sync();
+
+            // 노드 경계를 넘거나 노드가 비게/작아지는 삭제는 구조 변경이 필요하므로 일반 경로로 보낸다.
+            const size_t node_len = node->content_size();
+            const bool stays_in_node = node_offset + len < node_len;
+            const bool underflows = txt->eager_rebalance && node_len - len < NODE_MIN_SIZE;
+            if (!stays_in_node || underflows) {
+                txt->erase(pos, len);
+                node = nullptr;
+                return;
+            }
+
+            txt->erase_in_node(node, node_offset, len, update);
+            txt->snapshot_changes.note(pos, len, 0);
+            version = ++txt->edit_version;
+#ifdef BIMODAL_DEBUG
+            txt->debug_verify_spans();
+#endif
+        }
+
+    private:
+        static constexpr int WALK_LIMIT = 4;
+
+        BiModalText* txt;
+        size_t pos;
+        Node* node = nullptr;
+        size_t node_offset = 0;
+        uint64_t version = 0;
+        std::array<Node*, MAX_LEVEL> update;
+        std::array<size_t, MAX_LEVEL> rank;
+
+        bool cached() const { return node && version == txt->edit_version; }
+
+        void sync() {
+            if (cached()) return;
+            if (pos > txt->total_size) pos = txt->total_size;
+            node = txt->find_node(pos, node_offset, update, rank);
+            version = txt->edit_version;
+        }
+
+        // 대상 노드를 next[0] 으로 한 칸 옮기며 update[]/rank[] 를 보정한다.
+        void advance_node() {
+            const size_t node_end = rank[0] + node->content_size();
+            node_offset -= node->content_size();
+            for (int lvl = 0; lvl < node->level; ++lvl) {
+                update[lvl] = node;
+                rank[lvl] = node_end;
+            }
+            node = node->next[0];
+        }
+    };
+
+    Cursor cursor(size_t pos = 0) { return Cursor(*this, pos); }
     
     // --- [Ultimate Read Optimization] Internal Iterator ---
     // 람다 함수(func)를 받아서 모든 문자에 대해 실행합니다.
@@ -138,22 +279,11 @@ public:
     void scan(Func func) const {
         Node* curr = head->next[0];
         while (curr) {
-            assert(!curr->data.valueless_by_exception());
-            // std::visit 오버헤드를 노드당 1회로 줄임
-            std::visit([&](auto const& n) {
-                using T = std::decay_t<decltype(n)>;
-                
-                if constexpr (std::is_same_v<T, CompactNode>) {
-                    // [Fast Path] 연속된 메모리 -> 컴파일러가 SIMD 최적화하기 딱 좋음
-                    for (char c : n.data_span()) {
-                        func(c);
-                    }
-                } else {
-                    // GapNode: 두 덩어리로 나눠서 처리 (span 뷰 활용)
-                    for (char c : n.front_span()) func(c);
-                    for (char c : n.back_span()) func(c);
-                }
-            }, curr->data);
+            // 연속된 메모리 -> 컴파일러가 SIMD 최적화하기 딱 좋음
+            // (Compact 는 back_span 이 비어 있으므로 front 한 덩어리로 끝난다)
+            for (char c : curr->data.front_span()) func(c);
+            for (char c : curr->data.back_span()) func(c);
+            ++curr->reads;
             
             curr = curr->next[0];
         }
@@ -162,18 +292,34 @@ public:
 
     void insert(size_t pos, std::string_view s) {
         if (pos > total_size) throw std::out_of_range("Pos out of range");
+        snapshot_changes.note(pos, 0, s.size());
 
-        std::array<Node*, MAX_LEVEL> update;
-        std::array<size_t, MAX_LEVEL> rank;
         size_t node_offset = 0;
-
-        Node* target = find_node(pos, node_offset, update, rank);
+        Node* target = finger_search(pos, node_offset);
+        std::array<Node*, MAX_LEVEL> update = finger.update;
+        std::array<size_t, MAX_LEVEL> rank = finger.rank;
+        ++edit_version;
+
+        // 대량 삽입(붙여넣기): 노드 하나에 몰아넣고 split 하지 않고, 적정 크기 노드 런으로 바로 연결한다.
+        if (s.size() > NODE_MAX_SIZE) {
+            total_stats += insert_run(s, target, node_offset, update, rank);
+            total_size += s.size();
+#ifdef BIMODAL_DEBUG
+            debug_verify_spans();
+#endif
+            return;
+        }
 
         // [리팩토링] 빈 리스트 특수 케이스 -> Early Return 처리
         if (!target) {
             if (total_size == 0) {
                 target = create_node(random_level());
-                std::get<GapNode>(target->data).insert(0, s); // GapNode임을 확신하므로 바로 접근
+                gap_estimate.observe(target, 0, s.size());
+                target->data.gap_reserve = gap_estimate.reserve();
+                target->data.assign_gap();
+                target->data.insert(0, s);
+                target->stats = measure(s);
+                mark_dirty(target);
                 
                 for (int i = 0; i < MAX_LEVEL; ++i) {
                     if (i < target->level) {
@@ -182,8 +328,10 @@ public:
                         head->next[i] = nullptr;
                     }
                     head->span[i] = target->content_size();
+                    head->stat_span[i] = target->stats;
                 }
                 total_size += s.size();
+                total_stats = target->stats;
 #ifdef BIMODAL_DEBUG
                 debug_verify_spans();
 #endif
@@ -195,275 +343,1875 @@ public:
         
         // --- 이하 일반 케이스 (else 블록 제거로 들여쓰기 감소) ---
 
-        if (std::holds_alternative<CompactNode>(target->data)) {
-            target->data = expand(std::get<CompactNode>(target->data), false);
+        insert_into_node(target, node_offset, s, update);
+
+        if (target->content_size() > NODE_MAX_SIZE) {
+            split_node(target, update);
+        } else {
+            // 구조가 그대로이므로 finger 경로(앞선 노드들의 끝 위치)는 여전히 유효하다.
+            finger.version = edit_version;
+        }
+#ifdef BIMODAL_DEBUG
+        debug_verify_spans();
+#endif
+    }
+
+    // 읽기 경로는 finger/검색 인덱스 캐시(mutable)를 갱신하므로, const 읽기도 편집과 같은 스레드에서만 부른다.
+    // 다른 스레드에서 읽으려면 Reader(공개된 스냅숏)를 쓴다.
+    // 임의 접근은 적응형 모드의 읽기 카운터를 올리지 않는다. (카운터는 scan/chunks 같은 스캔 API 만 센다)
+    char at(size_t pos) const {
+        if (pos >= total_size) throw std::out_of_range("Index out of range");
+
+        size_t offset = 0;
+        Node* target = locate(pos, offset);
+        if (!target || offset >= target->content_size()) {
+#ifdef BIMODAL_DEBUG
+            std::cerr << "Final OOB: off=" << offset << "\n";
+            debug_dump_structure(std::cerr);
+#endif
+            throw std::runtime_error("Node structure corruption");
+        }
+
+        return target->data.at(offset);
+    }
+
+
+    // --- Chunk Iterator: 노드 내부의 연속 구간을 복사 없이 std::span 으로 내어 준다 ---
+    // - Compact 노드는 front_span 하나, Gap 노드는 front_span/back_span 두 개의 청크가 된다.
+    // - 범위 양 끝의 청크는 [pos, pos + len) 에 맞게 잘리며, 빈 청크는 건너뛴다.
+    // - 반환된 span 은 다음 편집 전까지만 유효하다.
+    class ChunkIterator {
+        const Node* node;
+        int part;                    // 0: data/front, 1: back
+        size_t remaining;            // 아직 내어 주지 않은 바이트 수
+        std::span<const char> chunk;
+
+        // (node, part) 부터 offset 을 건너뛰고, 비어 있지 않은 첫 청크에 멈춘다.
+        void settle(size_t offset) {
+            while (node && remaining > 0) {
+                std::span<const char> p = node_part(node, part);
+                if (offset < p.size()) {
+                    chunk = p.subspan(offset, std::min(p.size() - offset, remaining));
+                    return;
+                }
+                offset -= p.size();
+                if (part == 0) {
+                    part = 1;
+                } else {
+                    part = 0;
+                    node = node->next[0];
+                    if (node) ++node->reads;
+                }
+            }
+            node = nullptr;
+            part = 0;
+            chunk = {};
+        }
+
+    public:
+        ChunkIterator() : node(nullptr), part(0), remaining(0) {}
+        ChunkIterator(const Node* start, size_t offset, size_t len)
+            : node(start), part(0), remaining(len) {
+            if (node) ++node->reads;
+            settle(offset);
+        }
+
+        std::span<const char> operator*() const { return chunk; }
+
+        ChunkIterator& operator++() {
+            remaining -= chunk.size();
+            if (part == 0) {
+                part = 1;
+            } else {
+                part = 0;
+                node = node->next[0];
+                if (node) ++node->reads;
+            }
+            settle(0);
+            return *this;
+        }
+
+        bool operator!=(const ChunkIterator& other) const {
+            return node != other.node || part != other.part || chunk.data() != other.chunk.data();
+        }
+        bool operator==(const ChunkIterator& other) const { return !(*this != other); }
+    };
+
+    struct ChunkRange {
+        ChunkIterator first;
+        ChunkIterator last;
+        ChunkIterator begin() const { return first; }
+        ChunkIterator end() const { return last; }
+    };
+
+    // [pos, pos + len) 구간의 청크 범위. len 은 문서 끝에서 잘린다.
+    ChunkRange chunks(size_t pos = 0, size_t len = SIZE_MAX) const {
+        if (pos > total_size) throw std::out_of_range("Pos out of range");
+        len = std::min(len, total_size - pos);
+        if (len == 0) return {};
+        size_t offset = 0;
+        const Node* start = locate(pos, offset);
+        return {ChunkIterator(start, offset, len), ChunkIterator()};
+    }
+
+    // 청크 단위 방문자: func(std::span<const char>) 를 청크마다 한 번 호출한다.
+    // 해시/정규식/writev/SIMD 카운터처럼 블록 단위로 처리하는 소비자를 위한 것.
+    template <typename Func>
+    void for_each_chunk(size_t pos, size_t len, Func func) const {
+        for (std::span<const char> chunk : chunks(pos, len)) {
+            func(chunk);
+        }
+    }
+
+    // [Bulk Range Read] [pos, pos + len) 구간을 out 에 복사하고 복사한 바이트 수를 돌려준다.
+    // - 시작 노드만 (finger) 탐색으로 찾고, 이후에는 청크 단위로 통째로 memcpy 한다.
+    // - len 이 문서 끝을 넘으면 끝까지만 복사한다. (std::string::substr 와 같은 규칙)
+    size_t copy_range(size_t pos, size_t len, char* out) const {
+        size_t copied = 0;
+        for_each_chunk(pos, len, [&](std::span<const char> chunk) {
+            std::memcpy(out + copied, chunk.data(), chunk.size());
+            copied += chunk.size();
+        });
+        return copied;
+    }
+
+    std::string substr(size_t pos, size_t len) const {
+        if (pos > total_size) throw std::out_of_range("Pos out of range");
+        std::string res(std::min(len, total_size - pos), '\0');
+        copy_range(pos, res.size(), res.data());
+        return res;
+    }
+
+    // --- Line Index ---
+    // 각 노드의 줄바꿈 수(stats)와 레벨별 stat_span[] 을 이용해 at() 과 같은 O(log N) 하강으로 계산한다.
+    // 줄 번호는 0 부터 시작하며, 줄 수는 '\n' 개수 + 1 이다. (빈 문서도 1줄)
+
+    size_t line_count() const { return total_stats.newlines + 1; }
+
+    // pos 가 속한 줄 번호 (= [0, pos) 의 '\n' 개수)
+    size_t offset_to_line(size_t pos) const { return prefix_stats(pos).newlines; }
+
+    // line 번째 줄의 시작 오프셋 (= line 번째 '\n' 바로 다음 위치)
+    size_t line_to_offset(size_t line) const {
+        if (line > total_stats.newlines) throw std::out_of_range("Line out of range");
+        if (line == 0) return 0;
+
+        const Node* x = head;
+        size_t accumulated = 0;
+        size_t lines = 0;
+        for (int i = MAX_LEVEL - 1; i >= 0; --i) {
+            while (x->next[i] && lines + x->stat_span[i].newlines < line) {
+                accumulated += x->span[i];
+                lines += x->stat_span[i].newlines;
+                x = x->next[i];
+            }
+        }
+
+        // target 안에 (line - lines) 번째 '\n' 이 있다.
+        const Node* target = x->next[0];
+        size_t remaining = line - lines;
+        for (int part = 0; part < 2; ++part) {
+            std::span<const char> p = node_part(target, part);
+            const char* cur = p.data();
+            const char* end = p.data() + p.size();
+            while (cur < end) {
+                const char* nl = static_cast<const char*>(std::memchr(cur, '\n', end - cur));
+                if (!nl) break;
+                if (--remaining == 0) return accumulated + (nl - p.data()) + 1;
+                cur = nl + 1;
+            }
+            accumulated += p.size();
+        }
+        throw std::runtime_error("Line index corruption");
+    }
+
+    // --- UTF-8 Index ---
+    // 노드/레벨별 codepoints, utf16_units 집계로 코드포인트/UTF-16 위치를 O(log N) 에 바이트 위치로 바꾼다.
+    // 집계는 항상 유지되며, set_utf8_mode(true) 이면 노드 분할/런 생성/차용이 멀티바이트 시퀀스를 자르지 않는다.
+    // (바이트 위치로 시퀀스 중간을 직접 편집하는 것은 호출자 책임)
+
+    void set_utf8_mode(bool enable) { utf8_mode = enable; }
+
+    size_t codepoint_count() const { return total_stats.codepoints; }
+    size_t utf16_count() const { return total_stats.utf16_units; }
+
+    // [0, pos) 에서 시작하는 코드포인트 수 / UTF-16 단위 수
+    size_t offset_to_codepoint(size_t pos) const { return prefix_stats(pos).codepoints; }
+    size_t offset_to_utf16(size_t pos) const { return prefix_stats(pos).utf16_units; }
+
+    // cp 번째 코드포인트의 시작 바이트 위치 (cp == codepoint_count() 이면 size())
+    size_t codepoint_to_offset(size_t cp) const {
+        if (cp > total_stats.codepoints) throw std::out_of_range("Codepoint out of range");
+        return unit_to_offset(&TextStats::codepoints, cp);
+    }
+
+    // UTF-16 단위 u 를 포함하는 코드포인트의 시작 바이트 위치 (서로게이트 쌍 중간이면 쌍의 시작)
+    size_t utf16_to_offset(size_t u) const {
+        if (u > total_stats.utf16_units) throw std::out_of_range("UTF-16 index out of range");
+        return unit_to_offset(&TextStats::utf16_units, u);
+    }
+
+    char32_t codepoint_at(size_t cp) const {
+        if (cp >= total_stats.codepoints) throw std::out_of_range("Codepoint out of range");
+        size_t pos = codepoint_to_offset(cp);
+        const unsigned char lead = static_cast<unsigned char>(at(pos));
+        int extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+        char32_t c = extra == 0 ? lead : (lead & (0x3F >> extra));
+        for (int k = 1; k <= extra && pos + k < total_size; ++k) {
+            c = (c << 6) | (static_cast<unsigned char>(at(pos + k)) & 0x3F);
+        }
+        return c;
+    }
+
+    void insert_at_codepoint(size_t cp, std::string_view s) { insert(codepoint_to_offset(cp), s); }
+
+    void erase_codepoints(size_t cp, size_t count) {
+        if (cp >= total_stats.codepoints || count == 0) return;
+        size_t begin = codepoint_to_offset(cp);
+        size_t end = count >= total_stats.codepoints - cp ? total_size : codepoint_to_offset(cp + count);
+        erase(begin, end - begin);
+    }
+
+    // Iterator를 타지 않고, 노드 내부 버퍼를 통째로 append 하여 대역폭 활용 극대화
+    std::string to_string() const {
+        std::string res;
+        res.reserve(total_size);
+        Node* curr = head->next[0]; // Level 0 순회
+        while (curr) {
+            // Gap을 건너뛰고 두 덩어리로 복사 (Compact 는 Part 2 가 비어 있다)
+            const NodeData& d = curr->data;
+            res.append(d.buf.data(), d.gap_start);                        // Part 1: Gap 앞
+            res.append(d.buf.data() + d.gap_end, d.buf.size() - d.gap_end); // Part 2: Gap 뒤
+            curr = curr->next[0];
+        }
+        return res;
+    }
+
+    
+
+    void optimize() {
+        bump_layout_version();
+        optimize_pos = 0;   // 진행 중이던 optimize_step() 패스도 함께 끝난다
+        payload_pool->drain();   // 스냅숏이 놓은 공유 버퍼를 풀로 돌려준다
+
+        // lazy_compaction 이면 마지막 정리 이후 쓰인 노드만 Pending 으로 표시하고 끝낸다. (O(쓰인 노드 수))
+        // 검색 인덱스는 다시 만들지 않는다. 필요하면 읽기 경로(locate)가 조회 수에 맞춰 다시 만든다.
+        if (lazy_compaction && settle_dirty_nodes()) {
+#ifdef BIMODAL_DEBUG
+            debug_verify_spans();
+#endif
+            return;
+        }
+
+        // update[i]: 현재 노드보다 앞에 있는 레벨 i 의 마지막 노드 (병합 시 span 보정용)
+        std::array<Node*, MAX_LEVEL> update;
+        update.fill(head);
+
+        Node* curr = head->next[0];
+        while (curr) curr = optimize_node(curr, update);
+
+        // 편집 단계가 끝났으므로 읽기 경로용 검색 인덱스를 새로 만든다.
+        rebuild_index();
+#ifdef BIMODAL_DEBUG
+        debug_verify_spans();
+#endif
+    }
+    
+    struct OptimizeProgress {
+        size_t position;   // 이번 패스에서 정리를 마친 위치 (바이트)
+        size_t total;      // 현재 문서 크기
+        bool done;         // 패스가 끝났으면 true (다음 호출은 처음부터 새 패스를 시작한다)
+
+        double fraction() const { return total ? static_cast<double>(position) / total : 1.0; }
+    };
+
+    // [Incremental Optimize] optimize() 를 여러 번에 나눠 수행한다. (UI 유휴 프레임마다 한 조각씩)
+    // - 직전 호출이 멈춘 위치(바이트)부터 next[0] 을 따라 노드를 Compact 로 바꾸고 작은 노드를 병합한다.
+    // - 이번 호출에서 지나간 바이트가 max_bytes 이상이 되거나 max_time 이 지나면 멈춘다. (노드 단위로 확인하므로
+    //   최소 한 노드는 진행한다)
+    // - 사이사이의 편집은 허용된다. 이미 지나간 구간의 편집은 다음 패스에서 정리된다.
+    // - 패스가 끝나는 호출에서만 검색 인덱스를 다시 만든다.
+    OptimizeProgress optimize_step(size_t max_bytes,
+                                   std::chrono::microseconds max_time = std::chrono::microseconds::max()) {
+        using clock = std::chrono::steady_clock;
+        const bool timed = max_time != std::chrono::microseconds::max();
+        const clock::time_point deadline = timed ? clock::now() + max_time : clock::time_point::max();
+
+        bump_layout_version();
+        std::array<Node*, MAX_LEVEL> update;
+        size_t pos = std::min(optimize_pos, total_size);
+        Node* curr = seek_node_start(pos, update);
+        const size_t start = pos;
+        while (curr) {   // 예산이 작아도 호출마다 최소 한 노드는 진행한다
+            curr = optimize_node(curr, update);
+            pos += update[0]->content_size();   // update[0] 은 방금 정리를 마친 노드
+            if (pos - start >= max_bytes || (timed && clock::now() >= deadline)) break;
+        }
+
+#ifdef BIMODAL_DEBUG
+        debug_verify_spans();
+#endif
+        if (curr) {
+            optimize_pos = pos;
+            return {pos, total_size, false};
+        }
+        optimize_pos = 0;
+        rebuild_index();
+        return {total_size, total_size, true};
+    }
+
+    size_t size() const { return total_size; }
+
+    // [Opt-in] erase() 중 NODE_MIN_SIZE 미만으로 줄어든 노드를 즉시 이웃과 병합/차용한다.
+    // optimize()를 부르지 않는 장시간 세션에서도 노드 수와 탐색 깊이가 무한히 늘지 않는다.
+    void set_eager_rebalance(bool enable) { eager_rebalance = enable; }
+
+    // [Adaptive Mode] 노드별 읽기/쓰기 카운터로 모드를 고른다. optimize() 를 부를 단계 경계가 없는
+    // 혼합 작업(타이핑 중 백그라운드 분석기가 스캔)을 위한 것으로, 유휴 시점마다 조금씩 부르면 된다.
+    // - 읽기가 잦고 쓰기가 드문(reads >= MAINTAIN_READ_HOT, reads > writes * MAINTAIN_READ_WRITE_RATIO)
+    //   Gap/Pending 노드만 Compact 로 바꾸고, 쓰기가 잦은 타이핑 영역은 Gap 으로 둔다.
+    // - 방문한 노드의 카운터는 절반으로 줄인다. (오래된 접근 기록이 점점 사라진다)
+    // - 직전 호출이 멈춘 위치부터 이어서 돌며, 변환한 바이트 수가 budget 을 넘거나 한 바퀴를 돌면 멈춘다.
+    // - 구조(노드 경계/크기)는 바꾸지 않지만 버퍼를 옮기므로, 편집과 마찬가지로 청크/반복자를 무효화한다.
+    // 반환값: 이번 호출에서 Compact 로 바꾼 바이트 수
+    size_t maintain(size_t budget = NODE_MAX_SIZE * 16) {
+        if (total_size == 0) return 0;
+        if (maintain_pos >= total_size) maintain_pos = 0;
+
+        size_t offset = 0;
+        Node* curr = finger_search(maintain_pos, offset);
+        size_t pos = maintain_pos - offset;   // curr 의 시작 위치
+        size_t converted = 0;
+        for (size_t visited = 0; visited < allocated_nodes && converted < budget; ++visited) {
+            if (!curr) {
+                curr = head->next[0];
+                pos = 0;
+            }
+            NodeData& d = curr->data;
+            if (!d.is_compact() && curr->reads >= MAINTAIN_READ_HOT &&
+                curr->reads > uint64_t{curr->writes} * MAINTAIN_READ_WRITE_RATIO) {
+                d.to_compact();
+                converted += d.size();
+            }
+            curr->reads >>= 1;
+            curr->writes >>= 1;
+            pos += curr->content_size();
+            curr = curr->next[0];
+        }
+        maintain_pos = curr ? pos : 0;
+        return converted;
+    }
+
+    // [Lazy Compaction] optimize() 가 Gap 노드를 복사해 Compact 로 바꾸지 않고 Pending 으로 표시만 한다.
+    // - Pending 노드는 Gap 배치 그대로 읽히고(front/back 두 청크), 다음 쓰기에서 복사 없이 Gap 으로 돌아간다.
+    // - 편집 ↔ 분석 단계를 자주 오가는 큰 문서에서 optimize() 의 바이트 복사(O(bytes))를 없앤다.
+    // - optimize() 는 리스트 전체를 돌지 않고 마지막 정리 이후 쓰인 노드(dirty_nodes)만 방문한다.
+    //   그중 NODE_MIN_SIZE 미만이 된 노드가 있을 때만 병합을 위해 전체 패스를 한다.
+    // - 읽기가 잦은 Pending 노드는 maintain() 이 실제 Compact 로 바꾼다.
+    //   gap 만큼의 메모리는 그때까지 반납되지 않으며, 끄고 optimize() 를 부르면 모든 Pending 노드가 Compact 가 된다.
+    void set_lazy_compaction(bool enable) { lazy_compaction = enable; }
+
+    // [Bulk Load] 기존 내용을 버리고 s 로 문서 전체를 다시 구성한다.
+    // - insert(0, s)는 거대한 Gap 노드 하나를 만들고 split_node()로 한 번만 반으로 나누므로
+    //   큰 파일을 열면 노드 몇 개짜리 리스트가 되어 스킵 리스트의 의미가 사라진다.
+    // - 여기서는 입력을 NODE_MAX_SIZE 근처 크기의 Compact 노드들로 잘라 만들고,
+    //   레벨은 결정적으로 부여하며, 모든 span[]을 한 번의 선형 패스로 계산한다. (O(N))
+    void assign(std::string_view s) {
+        clear();
+        if (s.empty()) return;
+
+        std::vector<Node*> run;
+        const TextStats st = build_run(s, true, run);
+
+        std::array<Node*, MAX_LEVEL> update;
+        std::array<size_t, MAX_LEVEL> rank;
+        update.fill(head);
+        rank.fill(0);
+        splice_run(update, rank, run);
+
+        total_size = s.size();
+        total_stats = st;
+        snapshot_changes.note(0, 0, s.size());
+#ifdef BIMODAL_DEBUG
+        debug_verify_spans();
+#endif
+    }
+
+        
+    void clear() {
+        if (!head) return; 
+        ++edit_version;
+        snapshot_changes.note(0, total_size, 0);
+
+        // [중요 수정] 루프 시작점은 head가 아니라 head->next[0]이어야 합니다.
+        Node* curr = head->next[0]; 
+        
+        while (curr) {
+            Node* next = curr->next[0];
+            destroy_node(curr); // 데이터 노드만 삭제 (279번째 줄 추정)
+            curr = next;
+        }
+
+        // head는 살아있으므로 재사용을 위해 초기화합니다.
+        // 만약 위 루프에서 curr = head 로 시작했다면, 여기서 크래시가 납니다.
+        for (int i = 0; i < MAX_LEVEL; ++i) {
+            head->next[i] = nullptr; // (286번째 줄 추정)
+            head->span[i] = 0; 
+            head->stat_span[i] = TextStats{};
+        }
+
+        total_size = 0;
+        total_stats = TextStats{};
+    }
+
+    void erase(size_t pos, size_t len) {
+        if (pos >= total_size) return;
+        if (pos + len > total_size) len = total_size - pos;
+        snapshot_changes.note(pos, len, 0);
+
+        while (len > 0) {
+            size_t offset = 0;
+            Node* target = finger_search(pos, offset);
+            if (!target) break;
+            std::array<Node*, MAX_LEVEL> update = finger.update;
+            std::array<size_t, MAX_LEVEL> rank = finger.rank;
+            ++edit_version;
+
+            size_t available = target->content_size() - offset;
+            size_t del_len = std::min(len, available);
+
+            erase_in_node(target, offset, del_len, update);
+            len -= del_len;
+
+            if (target->content_size() == 0) {
+                remove_node(target, update);
+            } else if (eager_rebalance && target->content_size() < NODE_MIN_SIZE) {
+                rebalance_underflow(target, update, rank);
+            } else {
+                finger.version = edit_version;
+            }
+        }
+#ifdef BIMODAL_DEBUG
+        debug_verify_spans();
+#endif
+    }
+
+    // [pos, pos + len) 을 text 로 바꾸는 편집. pos 는 편집을 적용하기 전 문서 기준이다.
+    struct Edit {
+        size_t pos;
+        size_t len;
+        std::string_view text;
+    };
+
+    // [Batch Edit] 포매터/리팩토링 도구가 보내는 편집 묶음을 한 번의 전진 패스로 적용한다.
+    // - 편집은 pos 순으로 (안정) 정렬하며, 원본 기준으로 겹치면 std::invalid_argument 를 던진다.
+    //   (같은 pos 에서는 삽입이 삭제/교체보다 먼저이고, 삽입끼리는 주어진 순서대로 들어간다)
+    // - 앞에서부터 적용하면서 누적된 길이 변화만큼 위치를 보정하고, 편집 중인 노드(frontier)의 update[] 를 유지한다.
+    //   다음 편집이 가까우면 next[0] 으로 몇 노드 걸어가고, 멀면 finger search 로 뛴다. (정렬되어 있으므로 O(log d))
+    // - 같은 노드 안에서 끝나는 편집(분할/제거가 필요 없는 경우)은 노드 버퍼에만 적용한다.
+    //   교체는 gap 을 편집 끝(pos + len)으로 한 번만 옮겨 지울 바이트를 gap 에 합치고 그 자리에 쓴다. (NodeData::replace)
+    // - span/stat_span 보정은 배치 전체에서 누적해 두었다가, 레벨 i 의 선행 노드가 바뀔 때(frontier 가 그 레벨의 노드를
+    //   지나갈 때)와 배치 끝에서만 반영한다. 상위 레벨의 선행 노드는 거의 바뀌지 않으므로 대부분 한 번에 끝난다.
+    // - 그 밖의 편집(노드 경계를 넘는 삭제, 분할이 필요한 삽입 등)은 쌓인 보정을 반영한 뒤 erase()/insert() 로 처리한다.
+    void apply_edits(std::span<const Edit> edits) {
+        std::vector<const Edit*> order;
+        order.reserve(edits.size());
+        for (const Edit& e : edits) order.push_back(&e);
+        // 같은 pos 에서는 순수 삽입을 지우는 편집보다 앞에 둔다. (입력 순서와 무관하게 같은 배치는 같은 결과)
+        auto by_pos = [](const Edit* a, const Edit* b) {
+            return a->pos < b->pos || (a->pos == b->pos && a->len == 0 && b->len != 0);
+        };
+        if (!std::is_sorted(order.begin(), order.end(), by_pos)) {
+            std::stable_sort(order.begin(), order.end(), by_pos);
+        }
+        size_t prev_end = 0;
+        bool changes = false;
+        for (const Edit* e : order) {
+            if (e->pos < prev_end || e->pos > total_size || e->len > total_size - e->pos) {
+                throw std::invalid_argument("apply_edits: overlapping or out-of-range edit");
+            }
+            prev_end = e->pos + e->len;
+            changes |= e->len != 0 || !e->text.empty();
+        }
+        // 바뀌는 것이 없으면 finger/검색 인덱스를 버리지 않는다.
+        if (!changes) return;
+
+        ++edit_version;
+        // frontier: 지금 편집 중인 노드와 그 시작 위치, 레벨별 선행 노드
+        Node* node = nullptr;
+        size_t node_start = 0;
+        std::array<Node*, MAX_LEVEL> update;
+
+        // 변화량 누적 (크기는 2의 보수로 음수 허용)
+        //  - node_*: frontier 노드 하나의 변화량. 노드를 떠날 때 노드 집계값/인덱스에 반영하고 배치 누적에 더한다.
+        //  - grown/added/removed: 마지막 flush() 이후 배치 누적.
+        //  - mark_*[i]: update[i] 에 마지막으로 반영했을 때의 배치 누적. (반영할 양 = 누적 - mark)
+        size_t node_delta = 0;
+        TextStats node_added, node_removed;
+        size_t grown = 0;
+        TextStats added, removed;
+        std::array<size_t, MAX_LEVEL> mark_grown{};
+        std::array<TextStats, MAX_LEVEL> mark_added{};
+        std::array<TextStats, MAX_LEVEL> mark_removed{};
+
+        auto leave_node = [&]() {
+            node->stats += node_added;
+            node->stats -= node_removed;
+            index_patch(node, node_delta);
+            grown += node_delta;
+            added += node_added;
+            removed += node_removed;
+            node_delta = 0;
+            node_added = node_removed = TextStats{};
+        };
+        auto flush_level = [&](int i) {
+            update[i]->span[i] += grown - mark_grown[i];
+            update[i]->stat_span[i] += added - mark_added[i];
+            update[i]->stat_span[i] -= removed - mark_removed[i];
+            mark_grown[i] = grown;
+            mark_added[i] = added;
+            mark_removed[i] = removed;
+        };
+        // 쌓인 보정을 모두 반영하고 frontier 를 비운다. (구조를 바꾸는 편집, finger search 전, 배치 끝)
+        auto flush = [&]() {
+            if (!node) return;
+            leave_node();
+            for (int i = 0; i < MAX_LEVEL; ++i) flush_level(i);
+            total_size += grown;
+            total_stats += added;
+            total_stats -= removed;
+            grown = 0;
+            added = removed = TextStats{};
+            mark_grown.fill(0);
+            mark_added.fill(TextStats{});
+            mark_removed.fill(TextStats{});
+            node = nullptr;
+        };
+        // frontier 를 next[0] 으로 옮긴다. 지나간 노드가 있는 레벨은 선행 노드가 그 노드로 바뀌므로 그때 반영한다.
+        auto advance = [&]() {
+            leave_node();
+            for (int i = 0; i < node->level; ++i) {
+                flush_level(i);
+                update[i] = node;
+            }
+            node_start += node->content_size();
+            node = node->next[0];
+        };
+
+        std::ptrdiff_t shift = 0;   // 앞선 편집들로 인한 위치 변화
+        for (const Edit* e : order) {
+            const size_t pos = static_cast<size_t>(static_cast<std::ptrdiff_t>(e->pos) + shift);
+            shift += static_cast<std::ptrdiff_t>(e->text.size()) - static_cast<std::ptrdiff_t>(e->len);
+            if (e->len == 0 && e->text.empty()) continue;
+
+            // 삭제가 노드 끝에서 시작하면 다음 노드의 처음으로 본다.
+            for (int steps = 0; node && node->next[0] && steps < EDIT_WALK_LIMIT; ++steps) {
+                const size_t node_end = node_start + node->content_size();
+                if (pos < node_end || (pos == node_end && e->len == 0)) break;
+                advance();
+            }
+            if (!node || pos < node_start || pos > node_start + node->content_size()) {
+                // frontier 에서 멀면 쌓인 보정을 반영한 뒤 finger 로 pos 의 노드까지 전진한다.
+                flush();
+                size_t off = 0;
+                node = finger_search(pos, off);
+                if (node) {
+                    node_start = pos - off;
+                    update = finger.update;
+                }
+            }
+            if (node) {
+                const size_t size = node->content_size();
+                const size_t off = pos - node_start;
+                const size_t new_size = size - e->len + e->text.size();
+                const bool fits = off + e->len <= size && new_size > 0 && new_size <= NODE_MAX_SIZE &&
+                                  !(eager_rebalance && new_size < NODE_MIN_SIZE);
+                if (fits) {
+                    NodeData& d = node->data;
+                    if (e->len) node_removed += measure_range(node, off, e->len);
+                    if (!e->text.empty()) {
+                        gap_estimate.observe(node, off, e->text.size());
+                        d.gap_reserve = gap_estimate.reserve();
+                    }
+                    d.to_gap(e->text.empty());
+                    d.replace(off, e->len, e->text);
+                    node_added += measure(e->text);
+                    node_delta += e->text.size() - e->len;
+                    snapshot_changes.note(pos, e->len, e->text.size());
+                    ++node->writes;
+                    mark_dirty(node);
+                    continue;
+                }
+            }
+
+            flush();
+            if (e->len) erase(pos, e->len);
+            if (!e->text.empty()) insert(pos, e->text);
+
+            // 다음 편집을 위해 방금 편집한 끝 위치의 노드를 frontier 로 잡는다.
+            const size_t end = pos + e->text.size();
+            size_t off = 0;
+            Node* n = finger_search(end, off);
+            if (n) {
+                node = n;
+                node_start = end - off;
+                update = finger.update;
+            }
+        }
+        flush();
+        ++edit_version;   // frontier 경로의 span 이 바뀌었으므로 finger 를 무효화한다
+#ifdef BIMODAL_DEBUG
+        debug_verify_spans();
+#endif
+    }
+
+    // --- [Multi Cursor] ---
+    // 여러 커서(이름 일괄 변경 등)에 같은 키 입력을 apply_edits() 한 번의 왼쪽→오른쪽 스윕으로 적용한다.
+    // - 위치는 정렬/중복 제거된 상태로 유지하고, 편집 후 뒤쪽 커서는 앞선 편집만큼 자동으로 밀린다.
+    // - 삭제로 두 커서가 같은 위치가 되면 하나로 합친다. 인접 커서의 삭제 범위는 서로 겹치지 않게 잘린다.
+    // - Cursor 와 마찬가지로 MultiCursor 밖에서 일어난 편집은 위치에 반영되지 않는다. (문서 끝으로만 잘린다)
+    class MultiCursor {
+    public:
+        explicit MultiCursor(BiModalText& t) : txt(&t) {}
+
+        void add(size_t pos) {
+            pos = std::min(pos, txt->size());
+            auto it = std::lower_bound(cursors.begin(), cursors.end(), pos);
+            if (it == cursors.end() || *it != pos) cursors.insert(it, pos);
+        }
+
+        void clear() { cursors.clear(); }
+        size_t size() const { return cursors.size(); }
+        const std::vector<size_t>& positions() const { return cursors; }
+
+        void move_by(std::ptrdiff_t delta) {
+            const std::ptrdiff_t limit = static_cast<std::ptrdiff_t>(txt->size());
+            for (size_t& p : cursors) {
+                p = static_cast<size_t>(std::clamp(static_cast<std::ptrdiff_t>(p) + delta, std::ptrdiff_t{0}, limit));
+            }
+            merge_duplicates();
+        }
+
+        // 모든 커서 위치에 s 를 넣고, 각 커서를 삽입한 내용 뒤로 옮긴다.
+        void insert_here(std::string_view s) {
+            clamp_to_size();
+            edits.clear();
+            for (size_t p : cursors) edits.push_back({p, 0, s});
+            txt->apply_edits(edits);
+            for (size_t i = 0; i < cursors.size(); ++i) cursors[i] += (i + 1) * s.size();
+        }
+
+        // 백스페이스: 각 커서 앞의 n 바이트를 지운다. (앞 커서를 넘어가지 않는다)
+        void erase_before(size_t n) {
+            clamp_to_size();
+            edits.clear();
+            size_t prev = 0;
+            for (size_t p : cursors) {
+                const size_t from = std::max(p - std::min(n, p), prev);
+                edits.push_back({from, p - from, {}});
+                prev = p;
+            }
+            apply_erases();
+        }
+
+        // Delete: 각 커서 뒤의 n 바이트를 지운다. (다음 커서를 넘어가지 않는다)
+        void erase_here(size_t n) {
+            clamp_to_size();
+            edits.clear();
+            for (size_t i = 0; i < cursors.size(); ++i) {
+                const size_t limit = i + 1 < cursors.size() ? cursors[i + 1] : txt->size();
+                edits.push_back({cursors[i], std::min(n, limit - cursors[i]), {}});
+            }
+            apply_erases();
+        }
+
+    private:
+        BiModalText* txt;
+        std::vector<size_t> cursors;   // 정렬, 중복 없음
+        std::vector<Edit> edits;       // 스윕마다 재사용하는 편집 버퍼
+
+        void clamp_to_size() {
+            const size_t limit = txt->size();
+            if (!cursors.empty() && cursors.back() > limit) {
+                for (size_t& p : cursors) p = std::min(p, limit);
+                merge_duplicates();
+            }
+        }
+
+        void merge_duplicates() {
+            cursors.erase(std::unique(cursors.begin(), cursors.end()), cursors.end());
+        }
+
+        // edits[i] 는 cursors[i] 의 삭제 범위다. 삭제 후 커서는 범위의 시작으로, 이후 커서는 앞선 삭제만큼 당겨진다.
+        void apply_erases() {
+            txt->apply_edits(edits);
+            size_t removed = 0;
+            for (size_t i = 0; i < cursors.size(); ++i) {
+                cursors[i] = edits[i].pos - removed;
+                removed += edits[i].len;
+            }
+            merge_duplicates();
+        }
+    };
+
+    MultiCursor multi_cursor() { return MultiCursor(*this); }
+
+    // --- [Snapshot] ---
+    // 문서의 한 시점을 가리키는 불변 핸들. 백그라운드 인덱서가 to_string() 전체 복사 없이 안정된 내용을 읽는다.
+    // - 내용은 노드 payload 를 문서와 공유(copy-on-write)하는 영속 piece 트리(PieceTree)다. 바이트는 복사하지 않는다.
+    // - 문서는 마지막 snapshot() 의 트리(snapshot_base)와 그 뒤에 바뀐 구간(snapshot_changes)을 기억한다.
+    //   다음 snapshot() 은 바뀐 구간을 덮는 노드만 얼려 트리의 해당 구간을 갈아 끼우므로,
+    //   O(구간 수 * log n + 바뀐 노드 수) 이고 편집이 없으면 O(1) 이다. (처음 한 번만 노드 수에 비례)
+    // - 문서는 다음 snapshot() 을 증분으로 만들기 위해 snapshot_base 를 계속 쥐고 있다. 그래서 Snapshot/Version
+    //   핸들을 모두 놓아도 한 번 얼린 노드는 공유 상태로 남고, 그 뒤 노드에 처음 쓸 때마다 (핸들이 남아 있든 없든)
+    //   그 노드 하나를 copy-on-write 로 복사한다. 옛 payload 는 다음 snapshot()/checkout() 이 그 구간을 갈아 끼울
+    //   때까지 남는다. (노드마다 한 번, 최대 바뀐 노드 수만큼의 payload)
+    // - 핸들 복사는 shared_ptr 복사이며, 다른 스레드에서 읽거나 해제해도 되고 문서보다 오래 살아도 된다.
+    class Snapshot {
+    public:
+        Snapshot() = default;
+
+        size_t size() const { return tree.size(); }
+        bool empty() const { return size() == 0; }
+
+        char at(size_t pos) const {
+            if (pos >= size()) throw std::out_of_range("Index out of range");
+            return tree.at(pos);
+        }
+
+        // [pos, pos + len) 을 청크(std::span<const char>) 단위로 방문한다. len 은 끝에서 잘린다.
+        template <typename Func>
+        void for_each_chunk(size_t pos, size_t len, Func func) const {
+            tree.for_each_chunk(pos, len, func);
+        }
+
+        std::string to_string() const {
+            std::string res;
+            res.reserve(size());
+            for_each_chunk(0, size(), [&](std::span<const char> c) { res.append(c.data(), c.size()); });
+            return res;
+        }
+
+        // 모든 문자에 대해 func(char) 를 호출한다. (BiModalText::scan 과 같은 형태)
+        template <typename Func>
+        void scan(Func func) const {
+            for_each_chunk(0, size(), [&](std::span<const char> c) {
+                for (char ch : c) func(ch);
+            });
+        }
+
+    private:
+        friend class BiModalText;
+
+        explicit Snapshot(PieceTree t) : tree(std::move(t)) {}
+
+        PieceTree tree;
+    };
+
+    // 현재 내용의 스냅숏. 직전 스냅숏 이후 바뀐 구간만 트리에 반영한다.
+    Snapshot snapshot() {
+        refresh_snapshot_base();
+        return Snapshot(snapshot_base);
+    }
+
+    // --- [Versions / Undo] ---
+    // 버전은 스냅숏이다. 편집 그룹마다 commit() 으로 기록하고 checkout()/undo()/redo() 로 오간다.
+    // - 버전들은 piece 트리의 바뀌지 않은 부분 트리를 공유한다. commit() 은 증분 snapshot() 이므로
+    //   버전 하나의 메모리는 바뀐 노드의 payload 와 트리 경로 O(log n) 노드다.
+    // - checkout() 은 현재 내용(의 트리)과 버전의 트리를 비교해 앞뒤 공통 부분을 건너뛰고,
+    //   가운데 다른 구간만 지운 뒤 버전의 piece 를 공유하는 노드로 다시 연결한다. (바이트 복사 없음)
+    //   공통 부분은 공유된 부분 트리를 통째로 건너뛰며 찾으므로 O(log n + 다시 연결하는 노드 수) 이다.
+    // - 이후 편집은 건드린 노드만 copy-on-write 로 복사하므로, 큰 붙여넣기의 undo/redo 도 역연산 재생 없이 끝난다.
+    using Version = Snapshot;
+
+    // 문서 내용을 버전 v 로 바꾼다. (undo 기록은 건드리지 않는다)
+    void checkout(const Version& v) {
+        refresh_snapshot_base();
+        const PieceTree& cur = snapshot_base;
+        const size_t prefix = PieceTree::common_prefix(cur, v.tree);
+        const size_t suffix = std::min(PieceTree::common_suffix(cur, v.tree),
+                                       std::min(cur.size(), v.size()) - prefix);
+        relink(prefix, cur.size() - prefix - suffix, v.tree, v.size() - prefix - suffix);
+        // 내용이 v 와 같아졌으므로 v 를 다음 스냅숏의 기준으로 삼는다.
+        snapshot_base = v.tree;
+        snapshot_changes.ranges.clear();
+#ifdef BIMODAL_DEBUG
+        debug_verify_spans();
+#endif
+    }
+
+    // 편집 그룹을 끝내고 현재 내용을 undo 기록에 남긴다. redo 할 수 있던 버전들은 버려진다.
+    // 마지막 commit/undo/redo 이후 편집이 없으면 새 버전을 만들지 않는다.
+    Version commit() {
+        if (!history.empty() && history_edit_version == edit_version) return history[history_pos];
+        if (!history.empty()) history.resize(history_pos + 1);
+        history.push_back(snapshot());
+        history_pos = history.size() - 1;
+        history_edit_version = edit_version;
+        return history.back();
+    }
+
+    // 직전 버전으로 되돌린다. commit 하지 않은 편집이 있으면 먼저 마지막 commit 상태로 되돌린다.
+    bool undo() {
+        if (history.empty()) return false;
+        if (history_edit_version == edit_version) {
+            if (history_pos == 0) return false;
+            --history_pos;
+        }
+        checkout(history[history_pos]);
+        history_edit_version = edit_version;
+        return true;
+    }
+
+    // undo 한 버전을 다시 적용한다. 그 뒤에 편집이 있었으면 redo 할 수 없다.
+    bool redo() {
+        if (history_edit_version != edit_version || history_pos + 1 >= history.size()) return false;
+        ++history_pos;
+        checkout(history[history_pos]);
+        history_edit_version = edit_version;
+        return true;
+    }
+
+    // --- [Concurrent Readers] ---
+    // 쓰기 스레드 하나가 편집하는 동안 여러 읽기 스레드가 잠금 없이 at()/scan()/범위 읽기를 한다. (RCU 방식)
+    // - 쓰기 스레드는 편집 그룹(또는 프레임)마다 publish() 로 현재 내용의 스냅숏을 원자적으로 교체해 공개한다.
+    // - 읽기 스레드는 Reader 로 가장 최근 공개본을 읽는다. 공개본은 불변이므로 살아 있는 리스트의
+    //   next[]/버퍼/finger/검색 인덱스 같은 쓰기 쪽 상태를 전혀 건드리지 않는다.
+    // - 교체된 공개본은 바로 해제하지 않고 epoch 와 함께 retired 에 넣었다가, 그 epoch 이전에 들어온
+    //   읽기가 모두 끝난 뒤 쓰기 스레드가 해제한다. (읽기 쪽은 참조 카운트를 건드리지 않아 코어 수만큼 확장된다)
+    // - 읽기는 마지막 publish() 시점의 내용을 본다. publish() 전의 편집은 보이지 않는다.
+    // - publish() 비용은 증분 snapshot() 과 같다: 직전 publish() 이후 바뀐 노드만 얼리고 piece 트리의
+    //   O(log n) 경로만 새로 만든다. (편집이 없으면 트리 포인터 복사뿐) 대신 공개된 노드에 다시 쓰는 첫 편집은
+    //   그 노드 하나를 copy-on-write 로 복사한다. 교체된 공개본이 해제될 때도 그 공개본만 가진 트리 노드와
+    //   payload 만 풀려난다. (benchmark 의 Scenario G 가 편집마다 publish() 하는 비용을 잰다)
+    static constexpr size_t MAX_READERS = 64;
+
+private:
+    // [Concurrent Readers] 읽기 슬롯: 읽는 동안 시작 시점의 epoch, 쉬는 동안 0. (슬롯마다 캐시 라인 하나)
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> in_use{false};
+    };
+
+    // 읽기 구간 동안 슬롯에 epoch 를 걸어 둔다. (예외가 나도 풀린다)
+    // 같은 Reader 로 중첩해 읽으면 가장 바깥 구간만 epoch 를 걸고 푼다. (depth 는 Reader 의 읽기 깊이)
+    // 안쪽 구간이 먼저 풀면서 epoch 를 0 으로 만들면 바깥 읽기 중인 공개본이 회수될 수 있기 때문이다.
+    struct EpochGuard {
+        ReaderSlot& slot;
+        uint32_t& depth;
+        EpochGuard(ReaderSlot& s, uint32_t& d, const std::atomic<uint64_t>& global) : slot(s), depth(d) {
+            if (depth++ == 0) slot.epoch.store(global.load());
+        }
+        ~EpochGuard() {
+            if (--depth == 0) slot.epoch.store(0, std::memory_order_release);
+        }
+    };
+
+public:
+    // 현재 내용을 읽기 스레드에 공개하고, 더 이상 아무도 볼 수 없는 이전 공개본을 해제한다. (쓰기 스레드 전용)
+    void publish() {
+        const Snapshot* next = new Snapshot(snapshot());
+        const Snapshot* old = published.exchange(next);
+        if (old) retired.emplace_back(global_epoch.load(), old);
+        global_epoch.fetch_add(1);
+        reclaim();
+    }
+
+    // 회수 가능한 이전 공개본을 해제하고, 아직 남은 개수를 돌려준다. (쓰기 스레드 전용)
+    // epoch e 에 교체된 공개본은, 활동 중인 모든 읽기가 e 보다 뒤에 시작했으면 아무도 볼 수 없다.
+    size_t reclaim() {
+        uint64_t oldest = UINT64_MAX;
+        for (const ReaderSlot& slot : reader_slots) {
+            const uint64_t e = slot.epoch.load();
+            if (e != 0 && e < oldest) oldest = e;
+        }
+        std::erase_if(retired, [&](const std::pair<uint64_t, const Snapshot*>& r) {
+            if (r.first >= oldest) return false;
+            delete r.second;
+            return true;
+        });
+        return retired.size();
+    }
+
+    // 읽기 스레드 하나가 쓰는 핸들. 생성 시 읽기 슬롯을 하나 차지한다. (MAX_READERS 개가 넘으면 예외)
+    // 문서보다 먼저 소멸해야 한다.
+    class Reader {
+    public:
+        explicit Reader(const BiModalText& t) : txt(&t) {
+            for (ReaderSlot& s : t.reader_slots) {
+                bool expected = false;
+                if (s.in_use.compare_exchange_strong(expected, true)) {
+                    slot = &s;
+                    return;
+                }
+            }
+            throw std::runtime_error("Too many concurrent readers");
+        }
+
+        ~Reader() { slot->in_use.store(false, std::memory_order_release); }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // 가장 최근 공개본에 대해 func(const Snapshot&) 를 호출하고 그 결과를 값으로 돌려준다.
+        // 공개본은 func 가 끝날 때까지 해제되지 않는다. 참조를 돌려주는 func 는 컴파일되지 않으며,
+        // 포인터/span 처럼 공개본을 가리키는 값도 밖으로 들고 나가면 안 된다.
+        // func 안에서 같은 Reader 로 다시 read() 해도 된다. (안쪽 읽기는 더 새 공개본을 볼 수 있다)
+        template <typename Func>
+            requires (!std::is_reference_v<std::invoke_result_t<Func&, const Snapshot&>>)
+        auto read(Func&& func) const {
+            EpochGuard guard(*slot, depth, txt->global_epoch);
+            const Snapshot* s = txt->published.load();
+            static const Snapshot empty;
+            return func(s ? *s : empty);
+        }
+
+        size_t size() const {
+            return read([](const Snapshot& s) { return s.size(); });
+        }
+        char at(size_t pos) const {
+            return read([&](const Snapshot& s) { return s.at(pos); });
+        }
+
+    private:
+        const BiModalText* txt;
+        ReaderSlot* slot = nullptr;
+        mutable uint32_t depth = 0;   // 진행 중인 read() 중첩 깊이 (이 Reader 를 쓰는 스레드 전용)
+    };
+
+    bool can_undo() const {
+        return !history.empty() && (history_pos > 0 || history_edit_version != edit_version);
+    }
+    bool can_redo() const {
+        return history_edit_version == edit_version && history_pos + 1 < history.size();
+    }
+
+private:
+    static constexpr int MAX_LEVEL = 16;
+    static constexpr size_t NODE_MAX_SIZE = 4096; 
+    
+    // Node 헤더 + next/span/stat_span 배열 (+ NODE_INLINE_CAPACITY 만큼의 inline payload) 전용 풀.
+    // 가장 높은 레벨의 노드까지 풀에서 처리하도록 블록 상한을 지정한다.
+    static std::pmr::pool_options node_pool_options() {
+        std::pmr::pool_options opts;
+        opts.largest_required_pool_block =
+            sizeof(Node) + (sizeof(Node*) + sizeof(size_t) + sizeof(TextStats)) * MAX_LEVEL;
+        return opts;
+    }
+    std::pmr::unsynchronized_pool_resource pool{node_pool_options()};
+
+    // [Payload Arena] 노드 버퍼(NodeData::buf) 전용 풀. (PayloadPool)
+    // 크기 클래스별 free list 를 가지므로 split/expand/compact/remove_node 로 반납된 버퍼가
+    // 같은 크기 클래스의 다음 할당에 그대로 재사용된다. (malloc 왕복 없음)
+    // 분할 직전 Gap 버퍼(~NODE_MAX_SIZE * 2 + gap)까지 풀에서 처리하고, 그보다 큰 버퍼만 upstream 으로 간다.
+    // 스냅숏이 공유했던 버퍼는 snapshot()/optimize() 의 drain() 에서 풀로 돌아온다.
+    static std::pmr::pool_options payload_pool_options() {
+        std::pmr::pool_options opts;
+        opts.largest_required_pool_block = 4 * NODE_MAX_SIZE;
+        return opts;
+    }
+    std::shared_ptr<PayloadPool> payload_pool = std::make_shared<PayloadPool>(payload_pool_options());
+    Node* head;
+    size_t total_size;
+    TextStats total_stats;
+    bool eager_rebalance = false;
+    bool utf8_mode = false;
+    bool lazy_compaction = false;
+    size_t maintain_pos = 0;    // maintain() 이 다음에 이어서 볼 위치
+    size_t optimize_pos = 0;    // optimize_step() 패스가 다음에 이어서 정리할 위치
+    std::vector<Node*> dirty_nodes;   // 마지막 정리 이후 쓰인 노드 (Node::dirty_slot 으로 위치를 안다)
+
+    // [Snapshot] 마지막 snapshot() 의 트리와 그 뒤에 바뀐 구간. (refresh_snapshot_base() 가 둘을 맞춘다)
+    // 바뀐 구간은 기준 트리가 생긴 뒤에만 기록한다. (스냅숏을 쓰지 않는 문서는 편집마다 비용이 없다)
+    struct DirtyRanges {
+        // 현재 문서의 [start, start + len) 이 기준 트리의 base_len 바이트를 대신한다.
+        // 구간들은 정렬되어 있고 겹치지 않는다. 구간 밖은 기준 트리와 같고, 앞선 구간들의 길이 변화만큼 밀려 있다.
+        struct Range {
+            size_t start;
+            size_t len;
+            size_t base_len;
+        };
+        static constexpr size_t MAX_RANGES = 32;   // 넘으면 가장 가까운 두 구간을 합친다
+
+        std::vector<Range> ranges;
+        bool active = false;
+
+        // 현재 문서의 [pos, pos + erased) 가 inserted 바이트로 바뀌었다.
+        void note(size_t pos, size_t erased, size_t inserted) {
+            if (!active || (erased == 0 && inserted == 0)) return;
+            // 편집과 겹치거나 맞닿는 구간 [lo, hi) 를 하나로 합친다.
+            auto lo = std::partition_point(ranges.begin(), ranges.end(),
+                                           [&](const Range& r) { return r.start + r.len < pos; });
+            auto hi = lo;
+            size_t start = pos, end = pos + erased, covered = 0, base = 0;
+            for (; hi != ranges.end() && hi->start <= pos + erased; ++hi) {
+                start = std::min(start, hi->start);
+                end = std::max(end, hi->start + hi->len);
+                covered += hi->len;
+                base += hi->base_len;
+            }
+            base += (end - start) - covered;   // 합친 범위 중 구간 밖이던 부분은 기준 트리와 1:1
+            const Range merged{start, end - start - erased + inserted, base};
+            for (auto it = hi; it != ranges.end(); ++it) it->start += inserted - erased;
+            lo = ranges.erase(lo, hi);
+            if (merged.len || merged.base_len) ranges.insert(lo, merged);
+            if (ranges.size() > MAX_RANGES) coalesce();
+        }
+
+        // 사이 간격이 가장 작은 이웃 두 구간을 합친다. (간격은 기준 트리와 같은 내용이다)
+        void coalesce() {
+            size_t best = 0;
+            size_t best_gap = SIZE_MAX;
+            for (size_t i = 0; i + 1 < ranges.size(); ++i) {
+                const size_t gap = ranges[i + 1].start - (ranges[i].start + ranges[i].len);
+                if (gap < best_gap) {
+                    best_gap = gap;
+                    best = i;
+                }
+            }
+            Range& a = ranges[best];
+            const Range& b = ranges[best + 1];
+            a.len += best_gap + b.len;
+            a.base_len += best_gap + b.base_len;
+            ranges.erase(ranges.begin() + best + 1);
+        }
+    };
+    PieceTree snapshot_base;
+    DirtyRanges snapshot_changes;
+    uint64_t piece_rng = 0;   // 트리 노드 우선순위용 SplitMix64 상태
+
+    mutable std::array<ReaderSlot, MAX_READERS> reader_slots;
+    std::atomic<uint64_t> global_epoch{1};
+    std::atomic<const Snapshot*> published{nullptr};
+    std::vector<std::pair<uint64_t, const Snapshot*>> retired;   // (교체된 epoch, 공개본) - 쓰기 스레드 전용
+
+    // commit()/undo()/redo() 의 버전 기록. history_edit_version 은 마지막으로 기록/복원한 시점의 edit_version.
+    std::vector<Version> history;
+    size_t history_pos = 0;
+    uint64_t history_edit_version = 0;
+
+    // [Adaptive Gap] 연속 삽입(버스트) 길이의 이동 평균으로 새 gap 의 크기를 정한다.
+    // - 같은 노드에서 직전 삽입이 끝난 자리에 이어 쓰면 같은 버스트로 본다.
+    // - 짧은 타이핑 위주면 gap 이 MIN_GAP_SIZE 까지 줄어 수천 개 Gap 노드의 빈 공간이 줄고,
+    //   붙여넣기가 잦은 영역에서는 NODE_MAX_SIZE 까지 늘어 확장/복사가 줄어든다.
+    struct GapEstimator {
+        const Node* node = nullptr;         // 진행 중인 버스트의 노드와 다음 삽입이 이어질 위치
+        size_t next_offset = 0;
+        size_t burst = 0;                   // 진행 중인 버스트 길이
+        size_t average = DEFAULT_GAP_SIZE / 2;  // 끝난 버스트 길이의 이동 평균 (새 값 가중치 1/4)
+
+        void observe(const Node* n, size_t offset, size_t len) {
+            if (n != node || offset != next_offset) {
+                if (burst) average = (3 * average + burst) / 4;
+                burst = 0;
+                node = n;
+            }
+            burst += len;
+            next_offset = offset + len;
+        }
+
+        // 평균 버스트의 두 배를 확보한다. (초기값은 DEFAULT_GAP_SIZE)
+        uint32_t reserve() const {
+            const size_t want = 2 * std::max(average, burst);
+            return static_cast<uint32_t>(std::clamp(want, MIN_GAP_SIZE, NODE_MAX_SIZE));
+        }
+    };
+    GapEstimator gap_estimate;
+
+    static constexpr int EDIT_WALK_LIMIT = 8;   // apply_edits() 가 finger search 대신 next[0] 으로 걸어갈 최대 노드 수
+    static constexpr uint32_t MAINTAIN_READ_HOT = 4;
+    static constexpr uint32_t MAINTAIN_READ_WRITE_RATIO = 4;
+    uint64_t edit_version = 0;  // 커서/finger 캐시 무효화용 편집 카운터
+
+    // [Finger Search] 마지막 탐색 경로(레벨별 선행 노드와 그 끝 위치) 캐시.
+    // version 이 edit_version 과 같을 때만 유효하다. 구조를 바꾸지 않는 편집은
+    // 앞선 노드들의 끝 위치를 바꾸지 않으므로 편집 후 version 만 다시 맞춰 재사용한다.
+    struct Finger {
+        std::array<Node*, MAX_LEVEL> update;
+        std::array<size_t, MAX_LEVEL> rank;
+        uint64_t version = UINT64_MAX;
+    };
+    mutable Finger finger;
+
+    // [Search Index] 읽기 경로(at/chunks)용 위치 → 노드 조회 인덱스. (SoA)
+    // - nodes[k] 는 레벨 0 의 k 번째 노드, tree 는 노드 크기의 Fenwick 트리(1-based)이다.
+    //   노드 수 n 에 대해 연속 배열 두 개뿐이라 (10MB 문서 ≈ 수천 노드 → 수십 KB) 캐시에 상주하고,
+    //   조회는 tree 위의 이진 하강 + 대상 노드 접근 1회로 끝난다. (레벨마다 노드를 따라가지 않는다)
+    // - optimize() 가 다시 만들고, 노드 내부 편집(insert_into_node/erase_in_node)은 tree 를 O(log n) 으로 보정한다.
+    // - 노드가 생기거나 사라지거나 두 노드 사이 경계가 옮겨지면 무효화된다. 무효 상태에서 조회가 노드 수만큼
+    //   쌓이면 읽기 위주 구간으로 보고 다시 만든다. (재구성 O(n) 이 조회당 O(1) 로 상각된다)
+    struct SearchIndex {
+        std::vector<Node*> nodes;
+        std::vector<size_t> tree;
+        size_t top_step = 0;   // n 이하의 가장 큰 2의 거듭제곱
+        size_t misses = 0;     // 무효 상태에서의 조회 수
+        bool valid = false;
+    };
+    mutable SearchIndex search_index;
+    size_t allocated_nodes = 0;
+#ifdef BIMODAL_DEBUG
+    size_t created_nodes = 0;   // 지금까지 create_node() 횟수 (checkout 이 다시 연결한 노드 수 검사용)
+#endif
+    uint64_t rng_state;    // random_level() 용 SplitMix64 상태
+
+    size_t node_allocation_size(int level) const {
+        size_t next_bytes = sizeof(Node*) * level;
+        size_t span_bytes = sizeof(size_t) * level;
+        size_t stat_bytes = sizeof(TextStats) * level;
+        return sizeof(Node) + next_bytes + span_bytes + stat_bytes;
+    }
+
+    Node* create_node(int level) {
+        size_t total_bytes = node_allocation_size(level);
+        void* raw = pool.allocate(total_bytes, alignof(Node));
+        auto* node = new(raw) Node(level, payload_pool->resource());
+        char* aux = static_cast<char*>(raw) + sizeof(Node);
+        node->initialize_links(aux);
+        ++allocated_nodes;
+#ifdef BIMODAL_DEBUG
+        ++created_nodes;
+#endif
+        invalidate_index();
+        return node;
+    }
+
+    void destroy_node(Node* node) {
+        if (!node) return;
+        unmark_dirty(node);
+        --allocated_nodes;
+        invalidate_index();
+        size_t total_bytes = node_allocation_size(node->level);
+        node->~Node();
+        pool.deallocate(node, total_bytes, alignof(Node));
+    }
+
+    void rebuild_spans() {
+        if (!head) return;
+
+        Node* base = head;
+        while (base) {
+            for (int lvl = 0; lvl < base->level; ++lvl) {
+                Node* target = base->next[lvl];
+                size_t distance = 0;
+                TextStats stats;
+
+                // target 까지(없으면 꼬리까지)의 거리
+                Node* walker = base->next[0];
+                while (walker) {
+                    distance += walker->content_size();
+                    stats += walker->stats;
+                    if (walker == target) break;
+                    walker = walker->next[0];
+                }
+                base->span[lvl] = distance;
+                base->stat_span[lvl] = stats;
+            }
+            base = base->next[0];
+        }
+    }
+
+    // SplitMix64: 64비트 곱셈/시프트 몇 번으로 끝나는 정수 RNG
+    uint64_t next_random() {
+        uint64_t z = (rng_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // P = 0.25: 하위 비트 두 개가 모두 0 일 때마다 한 레벨 올라간다.
+    // 64비트 한 번 뽑아 trailing zero 수 / 2 로 레벨을 정한다. (double 변환/반복 추출 없음)
+    int random_level() {
+        static_assert(P == 0.25, "random_level() assumes P == 1/4 (two zero bits per level)");
+        const int lvl = 1 + std::countr_zero(next_random()) / 2;
+        return lvl < MAX_LEVEL ? lvl : MAX_LEVEL;
+    }
+
+    // 결정적 레벨: idx+1 이 4^k 로 나누어떨어지면 레벨 k+1.
+    // 무작위 레벨(P = 0.25)의 기대 분포를 그대로, 그러나 완벽하게 균형 잡힌 형태로 재현한다.
+    static int balanced_level(size_t idx) {
+        int lvl = 1;
+        size_t k = idx + 1;
+        while ((k & 3) == 0 && lvl < MAX_LEVEL) {
+            k >>= 2;
+            lvl++;
+        }
+        return lvl;
+    }
+
+    // s 를 NODE_MAX_SIZE 이하의 고른 크기 조각으로 나누어 Compact 노드 런을 만든다.
+    // - 조각 수 n = ceil(len / NODE_MAX_SIZE), 각 조각은 len / n (±1) 바이트라 꼬리 조각이 작게 남지 않는다.
+    // - balanced == true 이면 balanced_level(), 아니면 random_level()로 레벨을 정한다.
+    // - utf8_mode 이면 조각 경계를 멀티바이트 시퀀스 앞으로 당긴다. (최대 3바이트, 그만큼 조각 상한을 낮춘다)
+    // - 도중에 할당이 실패하면 이미 만든 노드를 정리하고 예외를 그대로 던진다.
+    // 반환값: 조각별 집계값의 합 (= measure(s), 호출자가 s 를 다시 세지 않도록)
+    TextStats build_run(std::string_view s, bool balanced, std::vector<Node*>& run) {
+        const size_t len = s.size();
+        TextStats total;
+        if (len == 0) return total;
+
+        const size_t cap = utf8_mode ? NODE_MAX_SIZE - 3 : NODE_MAX_SIZE;
+        const size_t count = (len + cap - 1) / cap;
+        const size_t base = len / count;
+        const size_t extra = len % count;
+
+        run.reserve(run.size() + count);
+        const size_t first = run.size();
+        try {
+            size_t off = 0;
+            size_t ideal_end = 0;
+            for (size_t i = 0; i < count; ++i) {
+                ideal_end += base + (i < extra ? 1 : 0);
+                size_t end = utf8_mode ? utf8_floor(s, ideal_end, off) : ideal_end;
+                size_t chunk = end - off;
+                Node* n = create_node(balanced ? balanced_level(i) : random_level());
+                run.push_back(n);
+                n->data.assign_compact(s.data() + off, s.data() + off + chunk);
+                n->stats = measure(s.substr(off, chunk));
+                total += n->stats;
+                off += chunk;
+            }
+        } catch (...) {
+            for (size_t i = first; i < run.size(); ++i) destroy_node(run[i]);
+            run.resize(first);
+            throw;
+        }
+        return total;
+    }
+
+    // 이미 만들어진 노드 런을 위치 경계에 한 번에 연결하고 span 을 한 번의 선형 패스로 채운다.
+    //
+    // [전제]
+    //  - update[i] 는 레벨 i 에서 삽입 경계 바로 앞(또는 경계를 덮는) 노드, rank[i] 는 그 노드의 끝 위치.
+    //  - 경계는 노드 사이에 있어야 한다. (update[0] 의 끝 == 삽입 위치)
+    //
+    // [span 계산]
+    //  - 런의 노드를 앞에서부터 붙이며 레벨별 마지막 노드(last[i])와 그 끝 위치(last_end[i])를 추적한다.
+    //  - 새 노드 n 이 레벨 i 에 등장하면 last[i]->span[i] = (n 의 끝) - last_end[i].
+    //  - 마지막으로 각 레벨의 last[i] 를 원래 후속 노드(없으면 꼬리)와 다시 잇는다.
+    //    원래 후속 노드의 끝 위치는 rank[i] + 기존 span[i] 이고, 삽입으로 K 만큼 밀려난다.
+    //    런이 등장하지 않는 레벨은 last[i] == update[i] 이므로 결과적으로 span[i] += K 가 된다.
+    //
+    // [stat_span 계산]
+    //  - 같은 계산을 update[i] 의 끝을 0 으로 하는 상대 좌표에서 한다.
+    //  - update[i] 끝 → 경계까지의 집계값(lead[i])은 update[i] 에서 레벨 i-1 로
+    //    update[i-1] 까지 걸어가며 구한다. (레벨당 기대 1/P 걸음)
+    //
+    // total_size / total_stats 갱신은 호출자의 몫이다.
+    void splice_run(const std::array<Node*, MAX_LEVEL>& update,
+                    const std::array<size_t, MAX_LEVEL>& rank,
+                    const std::vector<Node*>& run)
+    {
+        std::array<Node*, MAX_LEVEL> last = update;
+        std::array<size_t, MAX_LEVEL> last_end = rank;
+        std::array<Node*, MAX_LEVEL> succ;
+        std::array<size_t, MAX_LEVEL> succ_end;
+        std::array<TextStats, MAX_LEVEL> succ_stats;
+        std::array<TextStats, MAX_LEVEL> lead;
+        std::array<TextStats, MAX_LEVEL> last_stats;
+
+        for (int i = 0; i < MAX_LEVEL; ++i) {
+            succ[i] = update[i]->next[i];
+            succ_end[i] = rank[i] + update[i]->span[i];
+            succ_stats[i] = update[i]->stat_span[i];
+
+            lead[i] = (i == 0) ? TextStats{} : lead[i - 1];
+            if (i > 0 && update[i] != update[i - 1]) {
+                for (Node* x = update[i]; x != update[i - 1]; x = x->next[i - 1]) {
+                    lead[i] += x->stat_span[i - 1];
+                }
+            }
+            last_stats[i] = TextStats{};
+        }
+
+        const size_t start = rank[0];
+        size_t end = start;
+        TextStats run_stats;
+        for (Node* n : run) {
+            end += n->content_size();
+            run_stats += n->stats;
+            for (int i = 0; i < n->level; ++i) {
+                const TextStats n_stats = lead[i] + run_stats;
+                last[i]->next[i] = n;
+                last[i]->span[i] = end - last_end[i];
+                last[i]->stat_span[i] = n_stats - last_stats[i];
+                last[i] = n;
+                last_end[i] = end;
+                last_stats[i] = n_stats;
+            }
+        }
+
+        const size_t inserted = end - start;
+        for (int i = 0; i < MAX_LEVEL; ++i) {
+            last[i]->next[i] = succ[i];
+            last[i]->span[i] = succ_end[i] + inserted - last_end[i];
+            last[i]->stat_span[i] = succ_stats[i] + run_stats - last_stats[i];
+        }
+    }
+
+    // 대량 삽입 경로: s 를 NODE_MAX_SIZE 이하 노드들의 런으로 만들어 한 번에 연결한다.
+    // - target 중간에 삽입하는 경우, target 은 [0, node_offset) 만 남기고
+    //   잘린 suffix 는 런의 맨 끝 노드(들)로 붙인다. → 어느 노드도 NODE_MAX_SIZE 를 넘지 않는다.
+    // - 메가바이트 단위 붙여넣기여도 기존 노드 안에서 memmove 하지 않으며,
+    //   이후 그 영역의 편집 비용도 노드 크기로 제한된다.
+    // - 할당(예외 가능)은 모두 구조 변경 전에 끝낸다.
+    // 반환값: s 의 집계값 (런을 만들며 센 값)
+    TextStats insert_run(std::string_view s, Node* target, size_t node_offset,
+                         std::array<Node*, MAX_LEVEL>& update,
+                         std::array<size_t, MAX_LEVEL>& rank)
+    {
+        std::vector<Node*> run;
+        const TextStats inserted = build_run(s, false, run);
+        insert_nodes(run, target, node_offset, update, rank);
+        return inserted;
+    }
+
+    // 만들어 둔 노드 런을 target 의 node_offset 위치에 연결한다. (insert_run / checkout 공용)
+    // run 의 소유권을 넘겨받으며, 예외가 나면 run 의 노드를 정리하고 다시 던진다.
+    // target 의 잘린 suffix 가 run 끝에 붙으므로 호출 후 run 에는 그 노드(들)도 들어 있다.
+    void insert_nodes(std::vector<Node*>& run, Node* target, size_t node_offset,
+                      std::array<Node*, MAX_LEVEL>& update,
+                      std::array<size_t, MAX_LEVEL>& rank)
+    {
+        if (!target || node_offset == 0) {
+            // 경계가 이미 target 앞(또는 빈 리스트)이므로 update[] 그대로 연결한다.
+            splice_run(update, rank, run);
+            return;
         }
-        
-        // ... (나머지 로직 그대로)
-        std::get<GapNode>(target->data).insert(node_offset, s);
 
-        for (int i = 0; i < MAX_LEVEL; ++i) {
-            if (update[i]) {
-                update[i]->span[i] += s.size();
+        const size_t target_len = target->content_size();
+        const size_t suffix_len = target_len - node_offset;
+        TextStats suffix_stats;
+        if (suffix_len > 0) {
+            try {
+                std::string suffix;
+                suffix.reserve(suffix_len);
+                // front/back 조각을 node_offset 에서 잘라 두 번의 append 로 만든다.
+                size_t off = node_offset;
+                for (int part = 0; part < 2; ++part) {
+                    std::span<const char> p = node_part(target, part);
+                    if (off >= p.size()) {
+                        off -= p.size();
+                        continue;
+                    }
+                    suffix.append(p.data() + off, p.size() - off);
+                    off = 0;
+                }
+                suffix_stats = build_run(suffix, false, run);
+            } catch (...) {
+                for (Node* n : run) destroy_node(n);
+                throw;
             }
+
+            // --- No-Throw Section: target 을 prefix 로 자른다 ---
+            target->stats -= suffix_stats;
+            target->data.truncate(node_offset);
+            mark_dirty(target);
+            mark_dirty(run.back());   // 잘린 suffix 는 작을 수 있다
         }
 
-        if (target->content_size() > NODE_MAX_SIZE) {
-            split_node(target, update);
+        // 잘라낸 suffix 만큼 target 을 덮는 span 을 줄이고, target 이 존재하는 레벨에서는
+        // 경계 앞 노드를 target 으로 옮긴다. (target 의 끝 → 다음 노드 끝 거리는 변하지 않는다)
+        //  - target 이 있는 레벨:   update --(S - L)--> target --(T)--> next
+        //  - target 이 없는 레벨:   update --(S - L)--> next
+        // 이 상태는 "suffix 가 없는 문서"와 정확히 일치하고, splice_run 이 런 전체(s + suffix)를 더한다.
+        const size_t boundary = rank[0] + node_offset;
+        for (int i = 0; i < MAX_LEVEL; ++i) {
+            update[i]->span[i] -= suffix_len;
+            update[i]->stat_span[i] -= suffix_stats;
+            if (i < target->level) {
+                update[i] = target;
+                rank[i] = boundary;
+            }
         }
-        
-        total_size += s.size(); // *주의: Early return 했으므로 여기 도달하는 건 일반 케이스뿐임
-#ifdef BIMODAL_DEBUG
-        debug_verify_spans();
-#endif
+        splice_run(update, rank, run);
     }
 
-    char at(size_t pos) const {
-    if (pos >= total_size) throw std::out_of_range("Index out of range");
+    // [Versions] [pos, pos + old_len) 을 tree 의 [pos, pos + new_len) 으로 바꾼다.
+    // 바꿀 구간을 지우고, tree 의 piece 마다 그 payload 를 빌리는 노드를 만들어 pos 에 연결한다.
+    // (조각 piece 로 생긴 작은 노드나 Gap 노드는 dirty 로 표시해 다음 optimize() 가 정리한다)
+    void relink(size_t pos, size_t old_len, const PieceTree& tree, size_t new_len) {
+        if (old_len) erase(pos, old_len);
+        if (new_len == 0) return;
 
-    Node* x = head;
-    size_t accumulated = 0;
-    for (int i = MAX_LEVEL - 1; i >= 0; --i) {
-        while (x->next[i] && (accumulated + x->span[i] <= pos)) {  // ✅ <= 통일
-            accumulated += x->span[i];
-            x = x->next[i];
+        std::vector<Node*> run;
+        TextStats st;
+        try {
+            tree.for_each_piece(pos, new_len, [&](const PieceTree::Piece& p) {
+                Node* n = create_node(random_level());
+                run.push_back(n);
+                n->data.adopt(std::const_pointer_cast<FrozenPayload>(p.payload), p.front, p.back);
+                n->stats = p.stats;
+                st += p.stats;
+            });
+        } catch (...) {
+            for (Node* n : run) destroy_node(n);
+            throw;
         }
-    }
 
-    Node* target = x->next[0];
-    if (!target) {
-#ifdef BIMODAL_DEBUG
-        debug_dump_structure(std::cerr);
-#endif
-        throw std::runtime_error("Node structure corruption");
+        size_t node_offset = 0;
+        Node* target = finger_search(pos, node_offset);
+        std::array<Node*, MAX_LEVEL> update = finger.update;
+        std::array<size_t, MAX_LEVEL> rank = finger.rank;
+        ++edit_version;
+        insert_nodes(run, target, node_offset, update, rank);
+        for (Node* n : run) mark_dirty(n);
+        total_size += new_len;
+        total_stats += st;
     }
 
-    size_t offset = pos - accumulated;
-    // ✅ NEW: find_node 동일 skip 루프 (boundary off==sz → next off=0)
-    while (target && offset >= target->content_size()) {
-        accumulated += target->content_size();
-        target = target->next[0];
-        offset = pos - accumulated;
-    }
-    if (!target || offset >= target->content_size()) {
-#ifdef BIMODAL_DEBUG
-        std::cerr << "Final OOB: off=" << offset << " >= sz=" << target->content_size() << "\n";
-        debug_dump_structure(std::cerr);
-#endif
-        throw std::runtime_error("Final offset OOB");
+    // [Snapshot] 노드를 얼려 piece 트리의 piece 로 만든다. (payload 를 공유하며, 이후 쓰기는 copy-on-write)
+    PieceTree::Piece freeze_piece(Node* n) {
+        NodeData& nd = n->data;
+        return {nd.freeze(payload_pool), nd.front_span(), nd.back_span(), n->stats};
     }
 
-    return std::visit([offset](auto const& n) { return n.at(offset); }, target->data);
-}
-
+    // snapshot_base 를 현재 내용에 맞춘다.
+    // - 기준 트리가 없거나 잘린 piece 가 쌓여 노드 수의 두 배를 넘으면 모든 노드로 다시 만든다. (O(n), 상각)
+    // - 아니면 바뀐 구간을 앞에서부터 노드 경계까지 넓혀(겹치면 합쳐) 그 노드들만 얼리고 트리의 구간을 갈아 끼운다.
+    //   앞쪽 구간부터 처리하므로 처리 중인 구간 앞의 트리는 이미 현재 좌표와 같다.
+    //   트리에서 바꿀 길이 = 넓힌 현재 구간의 길이 + 포함된 구간들의 (base_len - len) 합.
+    void refresh_snapshot_base() {
+        payload_pool->drain();
+        std::vector<PieceTree::Piece> pieces;
+        if (!snapshot_changes.active || snapshot_base.piece_count() > 2 * allocated_nodes + 64) {
+            pieces.reserve(allocated_nodes);
+            for (Node* n = head->next[0]; n; n = n->next[0]) {
+                if (n->content_size()) pieces.push_back(freeze_piece(n));
+            }
+            snapshot_base = PieceTree::build(pieces, piece_rng);
+            snapshot_changes.ranges.clear();
+            snapshot_changes.active = true;
+            return;
+        }
 
-    // Iterator를 타지 않고, 노드 내부 버퍼를 통째로 append 하여 대역폭 활용 극대화
-    std::string to_string() const {
-        std::string res;
-        res.reserve(total_size);
-        Node* curr = head->next[0]; // Level 0 순회
-        while (curr) {
-            assert(!curr->data.valueless_by_exception());
-            std::visit([&](auto const& n) {
-                // 노드 타입에 따라 최적화된 블록 복사 수행
-                using T = std::decay_t<decltype(n)>;
-                if constexpr (std::is_same_v<T, CompactNode>) {
-                    // CompactNode: 한 방에 복사
-                    res.append(n.buf.data(), n.buf.size());
-                } else {
-                    // GapNode: Gap을 건너뛰고 두 덩어리로 복사
-                    // Part 1: Gap 앞
-                    res.append(n.buf.data(), n.gap_start);
-                    // Part 2: Gap 뒤
-                    size_t back_len = n.buf.size() - n.gap_end;
-                    res.append(n.buf.data() + n.gap_end, back_len);
+        const auto& ranges = snapshot_changes.ranges;
+        PieceTree tree = snapshot_base;
+        size_t k = 0;
+        while (k < ranges.size()) {
+            size_t off = 0;
+            Node* n = finger_search(ranges[k].start, off);
+            if (!n) {   // 빈 문서
+                tree = PieceTree();
+                break;
+            }
+            const size_t a = ranges[k].start - off;
+            size_t b = a;
+            size_t grow = 0;   // (base_len - len) 의 합 (2의 보수)
+            pieces.clear();
+            do {
+                const auto& r = ranges[k++];
+                grow += r.base_len - r.len;
+                // 구간 끝까지의 노드를 얼린다. 첫 구간은 (삭제만 있어도) 시작 노드를 반드시 포함한다.
+                while (n && (b == a || b < r.start + r.len)) {
+                    if (n->content_size()) pieces.push_back(freeze_piece(n));
+                    b += n->content_size();
+                    n = n->next[0];
                 }
-            }, curr->data);
-            curr = curr->next[0];
+            } while (k < ranges.size() && ranges[k].start <= b);
+            tree = tree.replace(a, b - a + grow, PieceTree::build(pieces, piece_rng));
         }
-        return res;
+        snapshot_base = std::move(tree);
+        snapshot_changes.ranges.clear();
     }
 
-    
+    // 노드의 part 번째 연속 구간 (0: front, 1: back — Compact 노드는 back 이 비어 있다)
+    static std::span<const char> node_part(const Node* n, int part) {
+        return part == 0 ? n->data.front_span() : n->data.back_span();
+    }
 
-    void optimize() {
-        Node* curr = head->next[0];
+    // 캐시(finger/검색 인덱스)와 읽기 카운터를 건드리지 않는 읽기. (pos < total_size)
+    // debug 검증이 검증 대상 상태(인덱스 재구성, maintain() 의 판단 근거)를 바꾸지 않도록 쓴다.
+    char peek(size_t pos) const {
+        const Node* x = head;
+        size_t accumulated = 0;
+        for (int i = MAX_LEVEL - 1; i >= 0; --i) {
+            while (x->next[i] && accumulated + x->span[i] <= pos) {
+                accumulated += x->span[i];
+                x = x->next[i];
+            }
+        }
+        return x->next[0]->data.at(pos - accumulated);
+    }
 
-        // [Phase 1] Transmutation: 모든 GapNode를 CompactNode로 변환
-        // - 메모리 단편화를 줄이고 읽기 속도(SIMD 친화적)를 확보합니다.
-        while (curr) {
-            if (std::holds_alternative<GapNode>(curr->data)) {
-                curr->data = compact(std::get<GapNode>(curr->data));
+    // [0, pos) 의 집계값: at() 과 같은 하강에서 stat_span[] 을 더하고, 마지막 노드는 직접 센다.
+    TextStats prefix_stats(size_t pos) const {
+        if (pos > total_size) throw std::out_of_range("Pos out of range");
+
+        const Node* x = head;
+        size_t accumulated = 0;
+        TextStats st;
+        for (int i = MAX_LEVEL - 1; i >= 0; --i) {
+            while (x->next[i] && accumulated + x->span[i] <= pos) {
+                accumulated += x->span[i];
+                st += x->stat_span[i];
+                x = x->next[i];
             }
-            curr = curr->next[0];
         }
 
+        const Node* target = x->next[0];
+        if (target) st += measure_range(target, 0, pos - accumulated);
+        return st;
     }
-    
-    size_t size() const { return total_size; }
 
-        
-    void clear() {
-        if (!head) return; 
+    // 집계 field 의 누적값이 k 를 넘는 첫 선행 바이트의 위치. (k == 전체 합이면 total_size)
+    size_t unit_to_offset(size_t TextStats::*field, size_t k) const {
+        if (k == total_stats.*field) return total_size;
 
-        // [중요 수정] 루프 시작점은 head가 아니라 head->next[0]이어야 합니다.
-        Node* curr = head->next[0]; 
-        
-        while (curr) {
-            Node* next = curr->next[0];
-            destroy_node(curr); // 데이터 노드만 삭제 (279번째 줄 추정)
-            curr = next;
+        const Node* x = head;
+        size_t accumulated = 0;
+        size_t units = 0;
+        for (int i = MAX_LEVEL - 1; i >= 0; --i) {
+            while (x->next[i] && units + x->stat_span[i].*field <= k) {
+                accumulated += x->span[i];
+                units += x->stat_span[i].*field;
+                x = x->next[i];
+            }
         }
 
-        // head는 살아있으므로 재사용을 위해 초기화합니다.
-        // 만약 위 루프에서 curr = head 로 시작했다면, 여기서 크래시가 납니다.
-        for (int i = 0; i < MAX_LEVEL; ++i) {
-            head->next[i] = nullptr; // (286번째 줄 추정)
-            head->span[i] = 0; 
+        const bool utf16 = field == &TextStats::utf16_units;
+        const Node* target = x->next[0];
+        for (int part = 0; part < 2; ++part) {
+            std::span<const char> p = node_part(target, part);
+            for (size_t j = 0; j < p.size(); ++j) {
+                size_t w = utf16 ? utf16_weight(p[j]) : !is_utf8_continuation(p[j]);
+                if (w > 0 && units + w > k) return accumulated + j;
+                units += w;
+            }
+            accumulated += p.size();
         }
-
-        total_size = 0;
+        throw std::runtime_error("UTF-8 index corruption");
     }
 
-    void erase(size_t pos, size_t len) {
-        if (pos >= total_size) return;
-        if (pos + len > total_size) len = total_size - pos;
+    // 노드 내용 [off, off + len) 의 집계값
+    static TextStats measure_range(const Node* n, size_t off, size_t len) {
+        TextStats st;
+        for (int part = 0; part < 2 && len > 0; ++part) {
+            std::span<const char> p = node_part(n, part);
+            if (off >= p.size()) {
+                off -= p.size();
+                continue;
+            }
+            size_t take = std::min(p.size() - off, len);
+            st += measure(p.subspan(off, take));
+            len -= take;
+            off = 0;
+        }
+        return st;
+    }
 
-        while (len > 0) {
-            std::array<Node*, MAX_LEVEL> update;
-            std::array<size_t, MAX_LEVEL> rank;
-            size_t offset = 0;
+    // 노드 내부 삽입: target 의 offset 에 s 를 넣고, target 을 덮는 모든 레벨의 span/stat_span 을 늘린다.
+    // (update[i] 는 레벨 i 에서 target 을 덮는 선행 노드)
+    void insert_into_node(Node* target, size_t offset, std::string_view s,
+                          const std::array<Node*, MAX_LEVEL>& update)
+    {
+        gap_estimate.observe(target, offset, s.size());
+        target->data.gap_reserve = gap_estimate.reserve();
+        target->data.to_gap(false);
+        target->data.insert(offset, s);
+        ++target->writes;
+        mark_dirty(target);
+
+        const TextStats st = measure(s);
+        for (int i = 0; i < MAX_LEVEL; ++i) {
+            update[i]->span[i] += s.size();
+            update[i]->stat_span[i] += st;
+        }
+        target->stats += st;
+        total_size += s.size();
+        total_stats += st;
+        index_patch(target, s.size());
+    }
 
-            Node* target = find_node(pos, offset, update, rank);
-            if (!target) break;
+    // 노드 내부 삭제: target 의 [offset, offset + len) 을 지우고 span/stat_span 을 줄인다.
+    void erase_in_node(Node* target, size_t offset, size_t len,
+                       const std::array<Node*, MAX_LEVEL>& update)
+    {
+        const TextStats st = measure_range(target, offset, len);
+        target->data.to_gap(true);
 
-            size_t available = target->content_size() - offset;
-            size_t del_len = std::min(len, available);
+        for (int i = 0; i < MAX_LEVEL; ++i) {
+            update[i]->span[i] -= len;
+            update[i]->stat_span[i] -= st;
+        }
+        target->data.erase(offset, len);
+        ++target->writes;
+        mark_dirty(target);
+
+        target->stats -= st;
+        total_size -= len;
+        total_stats -= st;
+        index_patch(target, 0 - len);
+    }
 
-            if (std::holds_alternative<CompactNode>(target->data)) {
-                target->data = expand(std::get<CompactNode>(target->data), true);
-            }
+    // 구조만 바뀌고 내용은 그대로인 작업(optimize)용 edit_version 증가.
+    // finger/커서 캐시는 무효화하되, undo 기록은 "편집 없음" 상태를 유지한다.
+    // (스냅숏 기준은 내용 구간으로 추적하므로 구조 변경의 영향을 받지 않는다)
+    void bump_layout_version() {
+        const bool history_clean = history_edit_version == edit_version;
+        ++edit_version;
+        if (history_clean) history_edit_version = edit_version;
+    }
 
-            for (int i = 0; i < MAX_LEVEL; ++i) {
-                if (update[i]) {
-                    update[i]->span[i] -= del_len;
-                }
+    // optimize()/optimize_step() 의 노드 하나 정리: 모드 전환 후 작은 이웃을 병합한다.
+    // update[i] 는 curr 앞의 레벨 i 마지막 노드이며, 정리를 마친 노드로 갱신된다. 다음에 볼 노드를 반환한다.
+    Node* optimize_node(Node* curr, std::array<Node*, MAX_LEVEL>& update) {
+        // [Phase 1] Transmutation: Gap 모드를 Compact 모드로 변환
+        // - 메모리 단편화를 줄이고 읽기 속도(SIMD 친화적)를 확보합니다.
+        // - lazy_compaction 이면 Pending 표시만 하고 복사는 미룬다. (편집 재진입 시 되돌리는 복사도 없음)
+        settle_mode(curr);
+
+        // [Phase 2] Coalescing: NODE_MIN_SIZE 미만의 노드는 이웃과 합쳐 NODE_MAX_SIZE 근처까지 채운다.
+        // - 잦은 백스페이스 후 남은 작은 노드들이 순차 읽기/탐색 깊이를 망가뜨리는 것을 막는다.
+        // - 레벨이 높은 쪽 노드를 남겨 상위 레벨 인덱스가 깎여 나가지 않게 한다.
+        Node* next = curr->next[0];
+        while (next && should_merge(curr, next)) {
+            settle_mode(next);
+            if (curr->level >= next->level) {
+                absorb_next(curr, next, update);
+            } else {
+                absorb_into_next(curr, next, update);
+                curr = next;
             }
+            next = curr->next[0];
+        }
+        curr->data.trim_slack();   // 병합용으로 넉넉히 잡은 용량을 노드 크기에 맞게 줄인다
 
-            std::get<GapNode>(target->data).erase(offset, del_len);
-            
-            total_size -= del_len;
-            len -= del_len;
+        for (int i = 0; i < curr->level; ++i) update[i] = curr;
+        return next;
+    }
 
-            if (target->content_size() == 0) {
-                remove_node(target, update);
+    // pos 이상에서 시작하는 첫 노드를 찾고 update[i] 에 레벨 i 의 선행 노드를 채운다.
+    // pos 가 노드 중간이면 그 노드를 반환하고 pos 를 노드 시작 위치로 당긴다.
+    Node* seek_node_start(size_t& pos, std::array<Node*, MAX_LEVEL>& update) const {
+        Node* x = head;
+        size_t accumulated = 0;
+        for (int i = MAX_LEVEL - 1; i >= 0; --i) {
+            while (x->next[i] && accumulated + x->span[i] <= pos) {
+                accumulated += x->span[i];
+                x = x->next[i];
             }
+            update[i] = x;
         }
-#ifdef BIMODAL_DEBUG
-        debug_verify_spans();
-#endif
+        pos = accumulated;
+        return x->next[0];
     }
 
-private:
-    static constexpr int MAX_LEVEL = 16;
-    static constexpr size_t NODE_MAX_SIZE = 4096; 
-    
-    std::pmr::unsynchronized_pool_resource pool;
-    Node* head;
-    size_t total_size;
-    std::mt19937 gen;
-    std::uniform_real_distribution<> dist;
+    // optimize() 의 모드 전환: 즉시 Compact 로 복사하거나, lazy_compaction 이면 Pending 표시만 한다.
+    // 정리된 노드는 dirty_nodes 에서 빠진다.
+    void settle_mode(Node* n) {
+        if (lazy_compaction) {
+            n->data.mark_compact_pending();
+        } else {
+            n->data.to_compact();
+        }
+        unmark_dirty(n);
+    }
 
-    size_t node_allocation_size(int level) const {
-        size_t next_bytes = sizeof(Node*) * level;
-        size_t span_bytes = sizeof(size_t) * level;
-        return sizeof(Node) + next_bytes + span_bytes;
+    // [Dirty List] 마지막 정리(optimize/optimize_step) 이후 쓰기·분할·차용으로 Gap 이 되었거나 크기가 바뀐 노드.
+    // 목록 밖의 노드는 이미 정리된(Compact/Pending) 상태이므로, lazy optimize() 는 이 목록만 보면 된다.
+    // 노드가 자기 위치(dirty_slot)를 알고 있어 추가/제거 모두 O(1) 이다. (제거는 마지막 항목과 자리 바꿈)
+    void mark_dirty(Node* n) {
+        if (n->dirty_slot) return;
+        dirty_nodes.push_back(n);
+        n->dirty_slot = dirty_nodes.size();
     }
 
-    Node* create_node(int level) {
-        size_t total_bytes = node_allocation_size(level);
-        void* raw = pool.allocate(total_bytes, alignof(Node));
-        auto* node = new(raw) Node(level);
-        char* aux = static_cast<char*>(raw) + sizeof(Node);
-        node->initialize_links(aux);
-        return node;
+    void unmark_dirty(Node* n) {
+        if (!n->dirty_slot) return;
+        Node* last = dirty_nodes.back();
+        dirty_nodes[n->dirty_slot - 1] = last;
+        last->dirty_slot = n->dirty_slot;
+        dirty_nodes.pop_back();
+        n->dirty_slot = 0;
     }
 
-    void destroy_node(Node* node) {
-        if (!node) return;
-        size_t total_bytes = node_allocation_size(node->level);
-        node->~Node();
-        pool.deallocate(node, total_bytes, alignof(Node));
+    // 목록의 노드만 정리한다. 병합이 필요할 수 있는(NODE_MIN_SIZE 미만) 노드가 있으면 아무것도 하지 않고 false.
+    // (병합에는 선행 노드가 필요하므로 그 경우는 전체 패스에 맡긴다)
+    bool settle_dirty_nodes() {
+        for (const Node* n : dirty_nodes) {
+            if (n->content_size() < NODE_MIN_SIZE) return false;
+        }
+        while (!dirty_nodes.empty()) settle_mode(dirty_nodes.back());
+        return true;
     }
 
-    void rebuild_spans() {
-        if (!head) return;
+    // 인접한 두 노드 중 하나라도 NODE_MIN_SIZE 미만이고, 합쳐도 NODE_MAX_SIZE 를 넘지 않으면 병합한다.
+    static bool should_merge(const Node* a, const Node* b) {
+        const size_t a_len = a->content_size();
+        const size_t b_len = b->content_size();
+        if (a_len + b_len > NODE_MAX_SIZE) return false;
+        return a_len < NODE_MIN_SIZE || b_len < NODE_MIN_SIZE;
+    }
 
-        Node* pred = head;
-        Node* node = head->next[0];
-        while (node) {
-            pred->span[0] = node->content_size();
-            pred = node;
-            node = node->next[0];
+    // b(= a->next[0])의 내용을 a 뒤에 붙이고 b 를 제거한다. (a->level >= b->level)
+    // update[i] 는 레벨 i 에서 a 의 선행 노드.
+    //
+    // [span 보정] 내용은 그대로이고 a 의 끝 위치만 b_len 만큼 뒤로 이동한다.
+    //  - a 의 선행 노드(update[i]): a 까지의 거리가 b_len 늘어난다.
+    //  - b 가 존재하던 레벨(i < b->level): a 가 b 의 링크/거리를 그대로 물려받는다.
+    //  - b 가 없던 레벨: a 에서 다음 노드까지의 거리가 b_len 줄어든다.
+    // a->level >= b->level 이므로 i >= a->level 인 레벨은 a, b 모두 없어 바뀌는 것이 없다.
+    void absorb_next(Node* a, Node* b, const std::array<Node*, MAX_LEVEL>& update) {
+        const size_t b_len = b->content_size();
+        const TextStats b_stats = b->stats;
+        a->data.merge(b->data, false);
+        a->stats += b_stats;
+        a->reads += b->reads;
+        a->writes += b->writes;
+
+        for (int i = 0; i < a->level; ++i) {
+            update[i]->span[i] += b_len;
+            update[i]->stat_span[i] += b_stats;
+            if (i < b->level) {
+                a->next[i] = b->next[i];
+                a->span[i] = b->span[i];
+                a->stat_span[i] = b->stat_span[i];
+            } else {
+                a->span[i] -= b_len;
+                a->stat_span[i] -= b_stats;
+            }
         }
-        if (pred) pred->span[0] = 0;
+        destroy_node(b);
+    }
 
-        Node* base = head;
-        while (base) {
-            for (int lvl = 1; lvl < base->level; ++lvl) {
-                Node* target = base->next[lvl];
-                size_t distance = 0;
+    // a 의 내용을 b(= a->next[0]) 앞에 붙이고 a 를 제거한다. (a->level < b->level)
+    //
+    // [span 보정] b 의 끝 위치는 그대로이므로, a 가 존재하던 레벨에서
+    // 선행 노드가 a 를 건너뛰어 b 를 직접 가리키고 a 의 거리를 더하기만 하면 된다.
+    // (a->level < b->level 이므로 a 의 모든 레벨에서 a->next[i] == b)
+    void absorb_into_next(Node* a, Node* b, const std::array<Node*, MAX_LEVEL>& update) {
+        b->data.merge(a->data, true);
+        b->stats += a->stats;
+        b->reads += a->reads;
+        b->writes += a->writes;
+
+        for (int i = 0; i < a->level; ++i) {
+            update[i]->next[i] = b;
+            update[i]->span[i] += a->span[i];
+            update[i]->stat_span[i] += a->stat_span[i];
+        }
+        destroy_node(a);
+    }
 
-                if (!target) {
-                    Node* walker = base->next[0];
-                    while (walker) {
-                        distance += walker->content_size();
-                        walker = walker->next[0];
-                    }
-                    base->span[lvl] = distance;
+    // a 와 b(= a->next[0]) 사이의 경계를 옮겨 두 노드의 크기를 고르게 만든다. (병합이 불가능할 때의 차용)
+    // - delta > 0 이면 b 의 앞 delta 바이트를 a 뒤로, delta < 0 이면 a 의 뒤 -delta 바이트를 b 앞으로 옮긴다.
+    // - 경계(= a 의 끝)만 이동하므로 a 가 존재하는 레벨의 span 만 보정하면 된다:
+    //     update[i] --(+delta)--> a --(-delta)--> ...
+    void borrow_between(Node* a, Node* b, const std::array<Node*, MAX_LEVEL>& update) {
+        const size_t a_len = a->content_size();
+        const size_t b_len = b->content_size();
+        size_t new_a_len = (a_len + b_len) / 2;
+        if (utf8_mode) {
+            auto byte_at = [&](size_t k) {
+                const Node* n = k < a_len ? a : b;
+                const size_t i = k < a_len ? k : k - a_len;
+                return n->data.at(i);
+            };
+            size_t p = new_a_len;
+            while (p > 0 && new_a_len - p < 3 && is_utf8_continuation(byte_at(p))) --p;
+            if (p > 0 && !is_utf8_continuation(byte_at(p))) new_a_len = p;
+        }
+        if (new_a_len == a_len) return;
+
+        invalidate_index();
+        a->data.to_gap(true);
+        b->data.to_gap(true);
+        mark_dirty(a);
+        mark_dirty(b);
+        auto& a_gap = a->data;
+        auto& b_gap = b->data;
+        // src 의 [off, off + n) 을 front/back 조각 그대로 dst 의 at 위치에 넣는다. (a, b 는 버퍼가 달라 중간 복사가 필요 없다)
+        auto insert_range = [](NodeData& dst, size_t at, const Node* src, size_t off, size_t n) {
+            for (int part = 0; part < 2 && n > 0; ++part) {
+                std::span<const char> p = node_part(src, part);
+                if (off >= p.size()) {
+                    off -= p.size();
                     continue;
                 }
-
-                Node* walker = base->next[0];
-                while (walker && walker != target) {
-                    distance += walker->content_size();
-                    walker = walker->next[0];
-                }
-
-                if (!walker) {
-                    // target vanished? fall back to tail distance
-                    walker = base->next[0];
-                    distance = 0;
-                    while (walker) {
-                        distance += walker->content_size();
-                        walker = walker->next[0];
-                    }
-                    base->span[lvl] = distance;
-                } else {
-                    distance += walker->content_size();
-                    base->span[lvl] = distance;
-                }
+                const size_t take = std::min(p.size() - off, n);
+                dst.insert(at, std::string_view(p.data() + off, take));
+                at += take;
+                n -= take;
+                off = 0;
+            }
+        };
+
+        if (new_a_len > a_len) {
+            const size_t moved = new_a_len - a_len;
+            const TextStats st = measure_range(b, 0, moved);
+            insert_range(a_gap, a_len, b, 0, moved);
+            b_gap.erase(0, moved);
+            a->stats += st;
+            b->stats -= st;
+            for (int i = 0; i < a->level; ++i) {
+                update[i]->span[i] += moved;
+                update[i]->stat_span[i] += st;
+                a->span[i] -= moved;
+                a->stat_span[i] -= st;
+            }
+        } else {
+            const size_t moved = a_len - new_a_len;
+            const TextStats st = measure_range(a, new_a_len, moved);
+            insert_range(b_gap, 0, a, new_a_len, moved);
+            a_gap.erase(new_a_len, moved);
+            a->stats -= st;
+            b->stats += st;
+            for (int i = 0; i < a->level; ++i) {
+                update[i]->span[i] -= moved;
+                update[i]->stat_span[i] -= st;
+                a->span[i] += moved;
+                a->stat_span[i] += st;
             }
-            base = base->next[0];
         }
     }
 
-    int random_level() {
-        int lvl = 1;
-        while (dist(gen) < P && lvl < MAX_LEVEL) lvl++;
-        return lvl;
+    // [Eager Underflow] erase 로 NODE_MIN_SIZE 미만이 된 target 을 이웃과 병합하거나 이웃에서 차용한다.
+    // - 기본은 다음 노드와 짝을 짓고(update[] 를 그대로 사용),
+    //   target 이 마지막 노드이면 이전 노드와 짝을 지으며 이전 노드의 선행 노드를 다시 찾는다.
+    // - 합쳐서 NODE_MAX_SIZE 이하면 병합, 아니면 경계를 옮겨 두 노드를 고르게 만든다.
+    void rebalance_underflow(Node* target,
+                             const std::array<Node*, MAX_LEVEL>& update,
+                             const std::array<size_t, MAX_LEVEL>& rank)
+    {
+        Node* left = target;
+        Node* right = target->next[0];
+        std::array<Node*, MAX_LEVEL> preds = update;
+
+        if (!right) {
+            if (update[0] == head) return;  // 노드가 하나뿐
+            left = update[0];
+            right = target;
+            std::array<size_t, MAX_LEVEL> left_rank;
+            size_t left_offset = 0;
+            find_node(rank[0] - 1, left_offset, preds, left_rank);
+        }
+
+        if (left->content_size() + right->content_size() <= NODE_MAX_SIZE) {
+            if (left->level >= right->level) {
+                absorb_next(left, right, preds);
+            } else {
+                absorb_into_next(left, right, preds);
+            }
+        } else {
+            borrow_between(left, right, preds);
+        }
     }
 
     Node* find_node(size_t pos, size_t& node_offset,
                     std::array<Node*, MAX_LEVEL>& update,
                     std::array<size_t, MAX_LEVEL>& rank) const 
     {
-        Node* x = head;
-        size_t accumulated = 0;
-        
         for(int i=0; i<MAX_LEVEL; ++i) update[i] = head;
+        return descend(head, 0, MAX_LEVEL - 1, pos, node_offset, update, rank);
+    }
 
-        for (int i = MAX_LEVEL - 1; i >= 0; --i) {
+    // x(끝 위치 accumulated)에서 레벨 top 부터 내려가며 pos 를 찾는다.
+    // top 보다 높은 레벨의 update[]/rank[] 는 호출자가 채워 둔 값을 그대로 쓴다.
+    Node* descend(Node* x, size_t accumulated, int top, size_t pos, size_t& node_offset,
+                  std::array<Node*, MAX_LEVEL>& update,
+                  std::array<size_t, MAX_LEVEL>& rank) const
+    {
+        for (int i = top; i >= 0; --i) {
             while (x->next[i] && (accumulated + x->span[i] < pos)) {
                 accumulated += x->span[i];
                 x = x->next[i];
@@ -492,10 +2240,100 @@ private:
         }
         return target;
     }
+
+    // --- Search Index ---
+
+    void invalidate_index() const {
+        search_index.valid = false;
+        search_index.misses = 0;
+    }
+
+    void rebuild_index() const {
+        SearchIndex& ix = search_index;
+        ix.nodes.clear();
+        ix.tree.assign(1, 0);
+        for (Node* n = head->next[0]; n; n = n->next[0]) {
+            n->index_slot = ix.nodes.size() + 1;
+            ix.nodes.push_back(n);
+            ix.tree.push_back(n->content_size());
+        }
+        // 선형 시간 Fenwick 구성: 각 칸을 자신을 덮는 부모 칸에 더한다.
+        const size_t n = ix.nodes.size();
+        for (size_t i = 1; i <= n; ++i) {
+            size_t parent = i + (i & (~i + 1));
+            if (parent <= n) ix.tree[parent] += ix.tree[i];
+        }
+        ix.top_step = n ? std::bit_floor(n) : 0;
+        ix.valid = true;
+        ix.misses = 0;
+    }
+
+    // pos 를 포함하는 노드 (pos < total_size). prefix(k) <= pos 인 가장 큰 k 를 이진 하강으로 찾는다.
+    Node* index_find(size_t pos, size_t& node_offset) const {
+        const SearchIndex& ix = search_index;
+        const size_t n = ix.nodes.size();
+        size_t k = 0;
+        for (size_t step = ix.top_step; step > 0; step >>= 1) {
+            if (k + step <= n && ix.tree[k + step] <= pos) {
+                k += step;
+                pos -= ix.tree[k];
+            }
+        }
+        node_offset = pos;
+        return ix.nodes[k];
+    }
+
+    // 노드 n 의 크기가 delta(2의 보수로 음수 허용)만큼 바뀐 것을 반영한다.
+    void index_patch(const Node* n, size_t delta) {
+        SearchIndex& ix = search_index;
+        if (!ix.valid) return;
+        for (size_t i = n->index_slot; i <= ix.nodes.size(); i += i & (~i + 1)) {
+            ix.tree[i] += delta;
+        }
+    }
+
+    // 읽기 경로의 위치 조회: 직전 finger 의 레벨 0 구간 안이면 finger 로(O(1)),
+    // 아니면 검색 인덱스로, 인덱스가 없으면 finger search 로 찾는다.
+    Node* locate(size_t pos, size_t& node_offset) const {
+        const Finger& f = finger;
+        if (f.version == edit_version) {
+            const Node* u = f.update[0];
+            const size_t r = f.rank[0];
+            if ((u == head || r < pos) && (!u->next[0] || pos <= r + u->span[0])) {
+                return finger_search(pos, node_offset);
+            }
+        }
+        if (!search_index.valid && ++search_index.misses > allocated_nodes) rebuild_index();
+        if (search_index.valid) return index_find(pos, node_offset);
+        return finger_search(pos, node_offset);
+    }
+
+    // [Finger Search] 직전 탐색 경로에서 출발해 pos 를 찾는다. (O(log d), d = 직전 위치와의 거리)
+    // - 레벨 0 부터 위로 올라가며, 선행 노드 update[i] 의 점프 구간 (rank[i], rank[i] + span[i]]
+    //   안에 pos 가 들어오는 첫 레벨을 찾고 거기서부터 다시 내려간다.
+    // - 그 위 레벨의 선행 노드는 점프 구간이 아래 레벨의 구간을 포함하므로 그대로 유효하다.
+    // - 결과 경로는 finger.update/rank 에 남으며, 캐시가 무효하면 head 에서 탐색한다.
+    Node* finger_search(size_t pos, size_t& node_offset) const {
+        Finger& f = finger;
+        if (f.version == edit_version) {
+            for (int i = 0; i < MAX_LEVEL; ++i) {
+                Node* u = f.update[i];
+                size_t r = f.rank[i];
+                bool after_start = (u == head) || r < pos;
+                bool before_end = !u->next[i] || pos <= r + u->span[i];
+                if (after_start && before_end) {
+                    return descend(u, r, i, pos, node_offset, f.update, f.rank);
+                }
+            }
+        }
+        Node* target = find_node(pos, node_offset, f.update, f.rank);
+        f.version = edit_version;
+        return target;
+    }
   
     
     void split_node(Node* u, std::array<Node*, MAX_LEVEL>& update) {
-        auto& u_gap = std::get<GapNode>(u->data);
+        auto& u_gap = u->data;
         
         // 1. 분할 크기 계산
         //
@@ -505,6 +2343,12 @@ private:
         //
         size_t total_size = u_gap.size();
         size_t split_point = total_size / 2;
+        if (utf8_mode) {
+            // 멀티바이트 시퀀스 중간이면 선행 바이트 앞으로 당긴다. (잘못된 시퀀스면 그대로)
+            size_t p = split_point;
+            while (p > 0 && split_point - p < 3 && is_utf8_continuation(u_gap.at(p))) --p;
+            if (p > 0 && !is_utf8_continuation(u_gap.at(p))) split_point = p;
+        }
         size_t v_size = total_size - split_point;
         
         // 2. [중요] 새로운 노드 'v' 먼저 생성
@@ -522,17 +2366,20 @@ private:
         try {
             // 3. split_right()를 사용하여 u에서 v로 데이터 이동
             //
-            //  - split_right(v_size)는 "오른쪽 v_size 만큼"을 잘라내서 반환한다.
+            //  - split_right(v_size, v->data)는 "오른쪽 v_size 만큼"을 잘라내서 v->data 에 담는다.
             //  - 호출 후:
-            //      * u_gap : [앞부분 split_point 문자]만 남도록 내부 버퍼가 변경됨
-            //      * 반환값 : [뒷부분 v_size 문자]를 담은 GapNode
-            //  - 그 반환값을 v_gap에 대입해서 새 노드 v의 데이터로 사용한다.
+            //      * u_gap   : [앞부분 split_point 문자]만 남도록 내부 버퍼가 변경됨
+            //      * v->data : [뒷부분 v_size 문자]를 담은 Gap 모드 (버퍼 할당자는 u 의 것을 이어받는다)
             //
-            auto& v_gap = std::get<GapNode>(v->data);
-            v_gap = u_gap.split_right(v_size);
+            u_gap.split_right(v_size, v->data);
+            v->stats = measure_range(v, 0, v_size);
+            v->reads = u->reads;    // 분할된 두 노드 모두 같은 (편집 중인) 영역이다
+            v->writes = u->writes;
+            mark_dirty(u);
+            mark_dirty(v);
             // 이 시점에서:
             //  - u_gap.size() == split_point
-            //  - v_gap.size() == v_size
+            //  - v->content_size() == v_size
         } catch (...) {
             // v 생성 이후 split 과정에서 예외가 나면
             // v를 정리한 뒤 예외를 그대로 다시 던져서 상위에서 처리하게 한다.
@@ -540,6 +2387,10 @@ private:
             throw;
         }
         
+        // 뒤쪽 집계값(v_stats)은 u 에서 v 로 넘어간다. 아래 span 보정과 같은 규칙으로 stat_span 도 보정한다.
+        const TextStats v_stats = v->stats;
+        u->stats -= v_stats;
+
         // --- 이 시점부터는 예외가 발생하지 않는다고 가정 (No-Throw Section) ---
         //     포인터/스팬 갱신 중에 예외가 터지면 skip list의 불변식이 깨질 수 있으므로,
         //     그 이전에 예외 가능성이 있는 작업(split_right, 할당 같은 것들)을 모두 끝낸다.
@@ -594,6 +2445,7 @@ private:
             //    update[i] 쪽 span 에서도 반영해야 한다.
             //
             update[i]->span[i] -= v_size;
+            update[i]->stat_span[i] -= v_stats;
             
             if (i < new_level) {
                 // [케이스 1] 이 레벨에서 v가 실제로 존재하는 경우
@@ -612,6 +2464,8 @@ private:
                 u->next[i] = v;
                 v->span[i] = u->span[i];  // v에서 다음까지의 거리 = 기존 u의 거리(U)
                 u->span[i] = v_size;      // u에서 v까지의 거리 = v의 문자 수
+                v->stat_span[i] = u->stat_span[i];
+                u->stat_span[i] = v_stats;
             } else {
                 // [케이스 2] 이 레벨에서 v는 존재하지 않는 경우
                 //
@@ -628,6 +2482,7 @@ private:
                 //   총합: (S - v_size) + (U + v_size) = S + U (불변식 유지)
                 //
                 u->span[i] += v_size;
+                u->stat_span[i] += v_stats;
             }
         }
     }
@@ -637,6 +2492,7 @@ private:
         if (!target) return;  // ✅ null 안전
 
         size_t removed_len = target->content_size();
+        const TextStats removed_stats = target->stats;
         for (int i = 0; i < MAX_LEVEL; ++i) {
             Node* prev = update[i];
             if (!prev || !prev->next[i]) continue;
@@ -645,12 +2501,14 @@ private:
                 assert(prev->span[i] >= removed_len);
 #endif
                 prev->span[i] = prev->span[i] - removed_len + target->span[i];
+                prev->stat_span[i] = prev->stat_span[i] - removed_stats + target->stat_span[i];
                 prev->next[i] = target->next[i];
             } else {
 #ifdef BIMODAL_DEBUG
                 assert(prev->span[i] >= removed_len);
 #endif
                 prev->span[i] -= removed_len;
+                prev->stat_span[i] -= removed_stats;
             }
         }
         destroy_node(target);
@@ -669,6 +2527,41 @@ bool BiModalText::debug_verify_spans(std::ostream& os) const {
         sum0 += curr->content_size();
         curr = curr->next[0];
     }
+    TextStats stats0;
+    for (const Node* n = head->next[0]; n; n = n->next[0]) {
+        TextStats actual = measure_range(n, 0, n->content_size());
+        if (!(actual == n->stats)) {
+            os << "[DEBUG FAIL] node stats newlines=" << n->stats.newlines
+               << " != actual=" << actual.newlines << "\n";
+            ok = false;
+        }
+        stats0 += actual;
+    }
+    if (!(stats0 == total_stats)) {
+        os << "[DEBUG FAIL] total newlines=" << total_stats.newlines
+           << " != actual=" << stats0.newlines << "\n";
+        ok = false;
+    }
+    if (search_index.valid) {
+        size_t k = 0;
+        size_t end = 0;
+        for (const Node* n = head->next[0]; n; n = n->next[0]) {
+            ++k;
+            end += n->content_size();
+            size_t prefix = 0;
+            for (size_t i = k; i > 0 && i < search_index.tree.size(); i -= i & (~i + 1)) prefix += search_index.tree[i];
+            if (k > search_index.nodes.size() || search_index.nodes[k - 1] != n ||
+                n->index_slot != k || prefix != end) {
+                os << "[DEBUG FAIL] search index mismatch at node " << k << "\n";
+                ok = false;
+                break;
+            }
+        }
+        if (k != search_index.nodes.size()) {
+            os << "[DEBUG FAIL] search index node count " << search_index.nodes.size() << " != " << k << "\n";
+            ok = false;
+        }
+    }
     if (sum0 != total_size) {
         os << "[DEBUG FAIL] L0 sum0=" << sum0 << " != total=" << total_size << "\n";
         ok = false;
@@ -690,7 +2583,7 @@ bool BiModalText::debug_verify_spans(std::ostream& os) const {
         }
     }
 
-    // 3) to_string() size 체크 + at() vs to_string() 샘플링
+    // 3) to_string() size 체크 + peek() vs to_string() 샘플링 (at() 은 캐시/카운터를 바꾸므로 쓰지 않는다)
     std::string full_str = to_string();
     if (full_str.size() != total_size) {
         os << "[DEBUG FAIL] to_string.size()=" << full_str.size() << " != total=" << total_size << "\n";
@@ -698,8 +2591,8 @@ bool BiModalText::debug_verify_spans(std::ostream& os) const {
     }
     const size_t N_CHECK = std::min<size_t>(total_size, 5000);
     for (size_t p = 0; p < N_CHECK; ++p) {
-        if (at(p) != full_str[p]) {
-            os << "[DEBUG FAIL] at(" << p << ")='" << at(p) << "' != to_str='" << full_str[p] << "'\n";
+        if (peek(p) != full_str[p]) {
+            os << "[DEBUG FAIL] peek(" << p << ")='" << peek(p) << "' != to_str='" << full_str[p] << "'\n";
             ok = false;
             break;
         }
@@ -731,6 +2624,19 @@ bool BiModalText::debug_verify_spans(std::ostream& os) const {
                 distance += walker->content_size();
             }
 
+            TextStats stats;
+            for (const Node* w = base->next[0]; w; w = w->next[0]) {
+                stats += w->stats;
+                if (w == target) break;
+            }
+            if (!(stats == base->stat_span[lvl])) {
+                os << "[DEBUG FAIL] node stat_span mismatch lvl=" << lvl
+                   << " newlines=" << stats.newlines
+                   << " stored=" << base->stat_span[lvl].newlines
+                   << "\n";
+                ok = false;
+            }
+
             if (distance != base->span[lvl]) {
                 os << "[DEBUG FAIL] node span mismatch lvl=" << lvl
                    << " distance=" << distance
@@ -753,14 +2659,13 @@ void BiModalText::debug_dump_structure(std::ostream& os) const {
         os << "N" << idx << "(off=" << off << ", sz=" << curr->content_size()
            << ", lvl=" << curr->level << ") ";
 
-        if (std::holds_alternative<CompactNode>(curr->data)) {
-            const CompactNode& cn = std::get<CompactNode>(curr->data);
-            os << "[COMPACT buf=" << cn.buf.size() << "]";
+        const NodeData& d = curr->data;
+        if (d.is_compact()) {
+            os << "[COMPACT buf=" << d.buf.size() << "]";
         } else {
-            const GapNode& gn = std::get<GapNode>(curr->data);
-            os << "[GAP buf=" << gn.buf.size()
-               << " gap=[" << gn.gap_start << "," << gn.gap_end << ")"
-               << " logical=" << gn.size() << "]";
+            os << (d.is_pending() ? "[PENDING buf=" : "[GAP buf=") << d.buf.size()
+               << " gap=[" << d.gap_start << "," << d.gap_end << ")"
+               << " logical=" << d.size() << "]";
         }
 
         // span 샘플 (상위 3레벨만)
@@ -775,4 +2680,44 @@ void BiModalText::debug_dump_structure(std::ostream& os) const {
     }
     os << "=== END DUMP ===\n";
 }
+
+size_t BiModalText::debug_node_count() const {
+    size_t count = 0;
+    for (const Node* curr = head->next[0]; curr; curr = curr->next[0]) ++count;
+    return count;
+}
+
+size_t BiModalText::debug_max_node_size() const {
+    size_t max_size = 0;
+    for (const Node* curr = head->next[0]; curr; curr = curr->next[0]) {
+        max_size = std::max(max_size, curr->content_size());
+    }
+    return max_size;
+}
+
+size_t BiModalText::debug_gap_node_count() const {
+    size_t count = 0;
+    for (const Node* curr = head->next[0]; curr; curr = curr->next[0]) {
+        if (!curr->data.is_compact()) ++count;
+    }
+    return count;
+}
+
+size_t BiModalText::debug_gap_slack() const {
+    size_t slack = 0;
+    for (const Node* curr = head->next[0]; curr; curr = curr->next[0]) {
+        const NodeData& d = curr->data;
+        if (!d.is_compact() && !d.buf.is_inline()) slack += d.buf.capacity() - d.size();
+    }
+    return slack;
+}
+
+size_t BiModalText::debug_compact_slack() const {
+    size_t slack = 0;
+    for (const Node* curr = head->next[0]; curr; curr = curr->next[0]) {
+        const NodeData& d = curr->data;
+        if (d.is_compact() && !d.buf.is_inline() && !d.buf.is_borrowed()) slack += d.buf.capacity() - d.size();
+    }
+    return slack;
+}
 #endif  // BIMODAL_DEBUG
@@ -1,72 +1,409 @@
 #pragma once
 
 #include <vector>
+#include <array>
 #include <string>
 #include <string_view>
-#include <variant>
+#include <memory>
+#include <memory_resource>
+#include <atomic>
+#include <mutex>
 #include <cstddef>
 #include <algorithm>
 #include <cstring>
 #include <span>
+#include <bit>
+#include <cstdint>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 constexpr size_t DEFAULT_GAP_SIZE = 1024;   // 필요시 값 조정 (기존 값 사용)
+constexpr size_t MIN_GAP_SIZE = 64;         // 적응형 gap 예약(gap_reserve)의 하한
 constexpr size_t NODE_MAX_SIZE = 4096;  // 노드 최대 크기
 constexpr size_t NODE_MIN_SIZE = 256;   // 병합 기준 등으로 쓰면 여기
 
-// --- 1. Compact Node ---
-struct CompactNode {
-    std::vector<char> buf;
-    
-    CompactNode() = default;
+// --- 0. Text Statistics ---
+// 바이트 수 외에 노드/레벨 span 별로 함께 유지하는 집계값.
+// span[] 과 같은 규칙(합으로 누적)으로 stat_span[] 에 저장되어 줄 번호/코드포인트 탐색 등에 쓰인다.
+//  - codepoints : UTF-8 선행 바이트(연속 바이트 10xxxxxx 가 아닌 바이트) 수
+//  - utf16_units: codepoints + 4바이트 시퀀스(서로게이트 쌍) 수
+// 모두 바이트 단위로 셀 수 있어, 멀티바이트 시퀀스가 노드 경계에 걸쳐도 합이 맞는다.
+struct TextStats {
+    size_t newlines = 0;
+    size_t codepoints = 0;
+    size_t utf16_units = 0;
+
+    TextStats& operator+=(const TextStats& o) {
+        newlines += o.newlines;
+        codepoints += o.codepoints;
+        utf16_units += o.utf16_units;
+        return *this;
+    }
+    TextStats& operator-=(const TextStats& o) {
+        newlines -= o.newlines;
+        codepoints -= o.codepoints;
+        utf16_units -= o.utf16_units;
+        return *this;
+    }
+    friend TextStats operator+(TextStats a, const TextStats& b) { return a += b; }
+    friend TextStats operator-(TextStats a, const TextStats& b) { return a -= b; }
+    friend bool operator==(const TextStats&, const TextStats&) = default;
+};
 
-    explicit CompactNode(std::vector<char>&& data) : buf(std::move(data)) {}
+inline bool is_utf8_continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
 
-    CompactNode(const CompactNode&) = default;
-    CompactNode& operator=(const CompactNode&) = default;
-    CompactNode(CompactNode&&) noexcept = default;
-    CompactNode& operator=(CompactNode&&) noexcept = default;
-    ~CompactNode() = default;
+// 바이트 하나가 차지하는 UTF-16 단위 수 (연속 바이트 0, 4바이트 선행 바이트 2, 나머지 1)
+inline size_t utf16_weight(char c) {
+    const unsigned char b = static_cast<unsigned char>(c);
+    if ((b & 0xC0) == 0x80) return 0;
+    return b >= 0xF0 ? 2 : 1;
+}
 
-    size_t size() const { return buf.size(); }
-    char at(size_t i) const { return buf[i]; }
+// '\n' / 선행 바이트 / 4바이트 선행 바이트를 한 번에 센다.
+// AVX2(32B) / SSE2(16B) 비교 + movemask + popcount, 나머지는 스칼라.
+//  - 선행 바이트: signed 로 보면 > -65 (0x80..0xBF 만 -128..-65)
+//  - 4바이트 선행: signed 로 보면 -16..-1 → (> -17) & 부호 비트
+inline TextStats measure(const char* p, size_t n) {
+    size_t newlines = 0, leads = 0, quads = 0;
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i cont_max = _mm256_set1_epi8(-65);
+    const __m256i quad_min = _mm256_set1_epi8(-17);
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        uint32_t neg = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+        newlines += std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl))));
+        leads += std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(v, cont_max))));
+        quads += std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(v, quad_min))) & neg);
+    }
+#elif defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i cont_max = _mm_set1_epi8(-65);
+    const __m128i quad_min = _mm_set1_epi8(-17);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        uint32_t neg = static_cast<uint32_t>(_mm_movemask_epi8(v));
+        newlines += std::popcount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl))));
+        leads += std::popcount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(v, cont_max))));
+        quads += std::popcount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(v, quad_min))) & neg);
+    }
+#endif
+    for (; i < n; ++i) {
+        const unsigned char b = static_cast<unsigned char>(p[i]);
+        newlines += (b == '\n');
+        leads += ((b & 0xC0) != 0x80);
+        quads += (b >= 0xF0);
+    }
+    return TextStats{newlines, leads, leads + quads};
+}
 
-    inline std::span<const char> data_span() const { return std::span<const char>(buf.data(), buf.size()); }
-    
-    std::string to_string() const {
-        return std::string(buf.begin(), buf.end());
+inline TextStats measure(std::span<const char> s) { return measure(s.data(), s.size()); }
+
+inline TextStats measure(std::string_view s) { return measure(s.data(), s.size()); }
+
+// off 를 (최대 3바이트) 앞으로 당겨 멀티바이트 시퀀스 중간이 아닌 위치로 맞춘다. lo 아래로는 내려가지 않는다.
+inline size_t utf8_floor(std::string_view s, size_t off, size_t lo = 0) {
+    size_t p = off;
+    if (off >= s.size()) return off;
+    while (p > lo && off - p < 3 && is_utf8_continuation(s[p])) --p;
+    return (p > lo && !is_utf8_continuation(s[p])) ? p : off;
+}
+
+// --- Inline Payload Buffer ---
+// 용량 N 까지는 버퍼 객체 안(= Node 할당 안)에 데이터를 두고, 넘치면 memory_resource(payload 풀)로 옮긴다.
+// Node 가 NodeData 를 값으로 가지므로 N > 0 이면 payload 가 Node 헤더/next/span 과 같은 할당에 놓여
+// 노드 방문 시 Node* → 힙 버퍼로의 두 번째 포인터 추적(캐시 미스)이 사라진다.
+// N == 0 이면 항상 풀에서 할당한다. (기존 std::pmr::vector<char> 와 같은 동작)
+//
+// - std::vector 처럼 resize() 로 늘어난 바이트는 0 으로 채운다.
+// - 이동 시 힙 버퍼는 포인터만 넘기고(할당자도 함께 넘어간다), inline 데이터는 복사한다.
+// - borrow() 로 남의 메모리를 읽기 전용으로 가리킬 수 있다. (스냅숏과 공유 중인 payload)
+//   빌린 버퍼에 쓰기 전에는 소유자(NodeData::unshare)가 먼저 자기 버퍼로 바꿔야 한다.
+template <size_t N>
+class InlineBuffer {
+public:
+    InlineBuffer() noexcept : InlineBuffer(std::pmr::get_default_resource()) {}
+
+    explicit InlineBuffer(std::pmr::memory_resource* mr) noexcept
+        : ptr(local()), len(0), cap(N), mr(mr) {}
+
+    InlineBuffer(size_t n, std::pmr::memory_resource* mr) : InlineBuffer(mr) { resize(n); }
+
+    InlineBuffer(const char* first, const char* last, std::pmr::memory_resource* mr) : InlineBuffer(mr) {
+        append(first, last);
+    }
+
+    InlineBuffer(const InlineBuffer& o) : InlineBuffer(o.mr) { append(o.begin(), o.end()); }
+
+    InlineBuffer(InlineBuffer&& o) noexcept : InlineBuffer(o.mr) { take(o); }
+
+    InlineBuffer& operator=(const InlineBuffer& o) {
+        if (this != &o) {
+            if (!owned) release();
+            len = 0;
+            append(o.begin(), o.end());
+        }
+        return *this;
+    }
+
+    InlineBuffer& operator=(InlineBuffer&& o) noexcept {
+        if (this != &o) {
+            release();
+            mr = o.mr;
+            take(o);
+        }
+        return *this;
+    }
+
+    ~InlineBuffer() { release(); }
+
+    char* data() { return ptr; }
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+    size_t capacity() const { return cap; }
+    bool is_inline() const { return ptr == local(); }
+    bool is_borrowed() const { return !owned; }
+    std::pmr::memory_resource* resource() const { return mr; }
+
+    char* begin() { return ptr; }
+    char* end() { return ptr + len; }
+    const char* begin() const { return ptr; }
+    const char* end() const { return ptr + len; }
+    char& operator[](size_t i) { return ptr[i]; }
+    char operator[](size_t i) const { return ptr[i]; }
+
+    void reserve(size_t n) {
+        if (n <= cap) return;
+        char* p = static_cast<char*>(mr->allocate(n, 1));
+        if (len) std::memcpy(p, ptr, len);
+        release();
+        ptr = p;
+        cap = n;
     }
+
+    void resize(size_t n) {
+        reserve(n);
+        if (n > len) std::memset(ptr + len, 0, n - len);
+        len = n;
+    }
+
+    // 늘어난 부분을 0 으로 채우지 않는 resize. (곧 덮어쓸 gap 영역용)
+    void resize_for_overwrite(size_t n) {
+        reserve(n);
+        len = n;
+    }
+
+    void append(const char* first, const char* last) {
+        const size_t n = static_cast<size_t>(last - first);
+        if (len + n > cap) reserve(std::max(len + n, cap * 2));
+        if (n) std::memcpy(ptr + len, first, n);
+        len += n;
+    }
+
+    // 남는 용량을 반납한다. N 이하로 줄었으면 inline 저장소로 되돌린다.
+    void shrink_to_fit() {
+        if (is_inline() || cap == len) return;
+        if (len <= N) {
+            char* old = ptr;
+            const size_t old_cap = cap;
+            if constexpr (N > 0) {
+                if (len) std::memcpy(local(), old, len);
+            }
+            ptr = local();
+            cap = N;
+            mr->deallocate(old, old_cap, 1);
+            return;
+        }
+        char* p = static_cast<char*>(mr->allocate(len, 1));
+        std::memcpy(p, ptr, len);
+        release();
+        ptr = p;
+        cap = len;
+    }
+
+    // 소유한 힙 버퍼를 해제하지 않고 (포인터, 용량) 으로 넘겨주고 빈 inline 상태가 된다.
+    // inline/빌린 버퍼면 {nullptr, 0} 이다. (해제는 받은 쪽이 할당자에 직접 한다)
+    std::pair<char*, size_t> detach() {
+        std::pair<char*, size_t> out{nullptr, 0};
+        if (owned && !is_inline()) out = {ptr, cap};
+        ptr = local();
+        len = 0;
+        cap = N;
+        owned = true;
+        return out;
+    }
+
+    // 기존 버퍼를 놓고 [p, p + n) 을 소유하지 않은 채 가리킨다. (할당자는 그대로 둔다)
+    void borrow(const char* p, size_t n) {
+        release();
+        ptr = const_cast<char*>(p);
+        len = cap = n;
+        owned = false;
+    }
+
+private:
+    char* local() { return storage.data(); }
+    const char* local() const { return storage.data(); }
+
+    void release() {
+        if (owned && !is_inline() && ptr) mr->deallocate(ptr, cap, 1);
+        ptr = local();
+        cap = N;
+        owned = true;
+    }
+
+    // o 의 내용을 가져온다. (this 는 비어 있는 inline 상태여야 한다)
+    void take(InlineBuffer& o) {
+        if (o.is_inline()) {
+            if constexpr (N > 0) {
+                if (o.len) std::memcpy(local(), o.ptr, o.len);
+            }
+        } else {
+            ptr = o.ptr;
+            cap = o.cap;
+            owned = o.owned;
+            o.ptr = o.local();
+            o.cap = N;
+            o.owned = true;
+        }
+        len = o.len;
+        o.len = 0;
+    }
+
+    char* ptr;
+    size_t len;
+    size_t cap;
+    std::pmr::memory_resource* mr;
+    bool owned = true;
+    std::array<char, N> storage;
 };
 
-// --- 2. Gap Node ---
-struct GapNode {
-    std::vector<char> buf;
-    size_t gap_start;
-    size_t gap_end;
+// 노드 payload 의 inline 용량. 빌드 시 -DBIMODAL_INLINE_CAPACITY=<bytes> 로 바꾼다.
+// (예: NODE_MAX_SIZE + DEFAULT_GAP_SIZE 이면 분할 전 Gap 버퍼까지 노드 할당 안에 들어간다)
+#ifndef BIMODAL_INLINE_CAPACITY
+#define BIMODAL_INLINE_CAPACITY 0
+#endif
+constexpr size_t NODE_INLINE_CAPACITY = BIMODAL_INLINE_CAPACITY;
+
+// 노드 payload 버퍼. 할당자는 BiModalText 인스턴스가 가진 payload 풀(크기 클래스별 재사용)을 가리키며,
+// to_gap()/to_compact()/split_right() 등에서 새로 만드는 버퍼도 원본의 할당자를 그대로 이어받는다.
+using CharBuffer = InlineBuffer<NODE_INLINE_CAPACITY>;
+
+// [Payload Arena] 노드 버퍼(NodeData::buf) 전용 풀.
+// 살아 있는 노드의 버퍼는 쓰기 스레드에서만 할당/해제되므로 풀 자체는 동기화하지 않는다. (편집마다 잠금 없음)
+// 스냅숏과 공유된 버퍼(FrozenPayload)는 읽기 스레드에서 마지막으로 해제될 수 있으므로 풀에 바로 돌려주지 않고
+// release() 로 returned 목록에 넣어 두었다가, 쓰기 스레드가 drain() 에서 한꺼번에 반납한다.
+// (잠금은 공유 버퍼 해제와 drain 에서만 잡는다)
+// FrozenPayload 들이 shared_ptr 로 함께 소유하므로 문서보다 늦게 해제되어도 된다. 풀이 사라질 때
+// returned 에 남은 버퍼도 풀 메모리와 함께 해제된다.
+class PayloadPool {
+public:
+    explicit PayloadPool(const std::pmr::pool_options& opts) : pool(opts) {}
+
+    PayloadPool(const PayloadPool&) = delete;
+    PayloadPool& operator=(const PayloadPool&) = delete;
+
+    std::pmr::memory_resource* resource() { return &pool; }
+
+    // 공유가 끝난 버퍼를 반납 대기열에 넣는다. (아무 스레드에서나 호출)
+    void release(CharBuffer& b) {
+        auto [p, cap] = b.detach();
+        if (!p) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        returned.emplace_back(p, cap);
+    }
 
-    // 생성자: 기본 용량 할당
-    explicit GapNode(size_t capacity = DEFAULT_GAP_SIZE) {
-        if (capacity < DEFAULT_GAP_SIZE) capacity = DEFAULT_GAP_SIZE;
-        buf.resize(capacity);
-        gap_start = 0;
-        gap_end = capacity;
+    // 반납 대기열의 버퍼를 풀에 돌려준다. (쓰기 스레드 전용)
+    void drain() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (returned.empty()) return;
+            draining.swap(returned);
+        }
+        for (auto [p, cap] : draining) pool.deallocate(p, cap, 1);
+        draining.clear();
     }
 
-    // Rule of Five
-    GapNode(const GapNode&) = default;
-    GapNode& operator=(const GapNode&) = default;
-    GapNode(GapNode&&) noexcept = default;
-    GapNode& operator=(GapNode&&) noexcept = default;
-    ~GapNode() = default;
+private:
+    std::pmr::unsynchronized_pool_resource pool;
+    std::mutex mutex;
+    std::vector<std::pair<char*, size_t>> returned;   // mutex 로 보호
+    std::vector<std::pair<char*, size_t>> draining;   // drain() 전용 (용량 재사용)
+};
 
-    // 논리적 크기 (Gap 제외)
-    size_t size() const {
-        return buf.size() - (gap_end - gap_start);
+// 스냅숏과 노드가 함께 가리키는 불변 payload. (copy-on-write)
+// - 노드는 buf 를 borrow() 로 그대로 읽고, 처음 쓸 때 NodeData::unshare() 로 자기 버퍼를 다시 갖는다.
+// - pool 은 buf 의 할당자를 살려 두고, 해제 시 buf 를 pool 의 반납 대기열로 보낸다.
+struct FrozenPayload {
+    std::shared_ptr<PayloadPool> pool;
+    CharBuffer buf;
+
+    FrozenPayload(std::shared_ptr<PayloadPool> p, CharBuffer&& b)
+        : pool(std::move(p)), buf(std::move(b)) {}
+    FrozenPayload(const FrozenPayload&) = delete;
+    FrozenPayload& operator=(const FrozenPayload&) = delete;
+    ~FrozenPayload() { pool->release(buf); }
+};
+
+// --- 1. Node Data (flat tagged layout) ---
+// Gap/Compact 두 모드를 하나의 버퍼와 헤더 필드로 표현한다. (std::variant / std::visit 없음)
+//
+//   Gap     : buf = [front: 0..gap_start) [gap] [back: gap_end..buf.size())
+//   Compact : buf = [data: 0..len), gap_start == gap_end == len (빈 gap)
+//
+// - len 은 논리 크기 캐시이므로 size() 는 필드 하나를 읽는다.
+// - Compact 의 gap 이 비어 있으므로 at()/front_span()/back_span() 은 모드 분기 없이 같은 식으로 동작한다.
+// - 편집(insert/erase/move_gap)은 Gap 모드에서만 호출한다. (호출자가 to_gap() 으로 먼저 전환)
+// - Pending 은 "Compact 로 바꿀 예정"인 Gap 버퍼다. (lazy optimize) 버퍼 배치는 Gap 과 같아서 그대로 읽을 수 있고,
+//   다음 쓰기의 to_gap() 은 복사 없이 표시만 Gap 으로 되돌린다.
+struct NodeData {
+    enum class Mode : uint8_t { Gap, Compact, Pending };
+
+    // to_compact() 가 반납하지 않고 남겨 두는 여유 용량: 논리 크기의 1/COMPACT_SLACK_DIVISOR, 최대 COMPACT_SLACK_LIMIT.
+    // 노드 크기에 비례하므로 optimize() 후 문서 전체의 빈 용량도 문서 크기의 1/16 이하로 묶인다.
+    static constexpr size_t COMPACT_SLACK_DIVISOR = 16;
+    static constexpr size_t COMPACT_SLACK_LIMIT = 2 * DEFAULT_GAP_SIZE;
+
+    CharBuffer buf;
+    size_t len = 0;
+    size_t gap_start = 0;
+    size_t gap_end = 0;
+    Mode mode = Mode::Compact;
+    uint32_t gap_reserve = DEFAULT_GAP_SIZE;  // 삽입용 gap 을 새로 열 때 확보할 크기 (소유자가 삽입 패턴에 맞춰 갱신)
+    std::shared_ptr<FrozenPayload> frozen;    // 스냅숏과 공유 중이면 buf 는 frozen->buf 를 빌린 상태다
+
+    NodeData() = default;
+
+    // 빈 Compact (할당 없음)
+    explicit NodeData(std::pmr::memory_resource* mr) : buf(mr) {}
+
+    // 복사 금지: 빌린 buf 를 복사하면 frozen 과 무관한 소유 버퍼가 되어 COW 상태가 어긋난다.
+    // 노드 내용을 옮길 때는 move 하거나 freeze()/adopt() 를 거친다.
+    NodeData(const NodeData&) = delete;
+    NodeData& operator=(const NodeData&) = delete;
+    NodeData(NodeData&&) noexcept = default;
+    NodeData& operator=(NodeData&&) noexcept = default;
+    ~NodeData() = default;
+
+    bool is_compact() const { return mode == Mode::Compact; }
+    bool is_gap() const { return mode == Mode::Gap; }
+    bool is_pending() const { return mode == Mode::Pending; }
+
+    // Gap 버퍼를 Compact 예정으로 표시만 한다. (O(1), 복사 없음)
+    void mark_compact_pending() {
+        if (mode == Mode::Gap) mode = Mode::Pending;
     }
 
-    // 논리 인덱스 -> 물리 인덱스 변환
+    // 논리적 크기 (Gap 제외)
+    size_t size() const { return len; }
+
+    // 논리 인덱스 -> 물리 인덱스 변환 (Compact 는 gap 길이가 0)
     size_t physical_index(size_t logical_idx) const {
-        if (logical_idx < gap_start) return logical_idx;
-        return logical_idx + (gap_end - gap_start);
+        return logical_idx + (logical_idx >= gap_start ? gap_end - gap_start : 0);
     }
 
     // 문자 접근
@@ -82,8 +419,70 @@ struct GapNode {
         return std::span<const char>(buf.data() + gap_end, buf.size() - gap_end);
     }
 
+    // 버퍼를 불변 payload 로 옮겨 스냅숏과 공유하고, 자신은 그것을 빌려 읽는다.
+    // 힙 버퍼는 포인터만 넘어가므로 복사가 없다. (inline 데이터는 payload 안으로 복사된다)
+    const std::shared_ptr<FrozenPayload>& freeze(const std::shared_ptr<PayloadPool>& pool) {
+        if (!frozen) {
+            frozen = std::make_shared<FrozenPayload>(pool, std::move(buf));
+            buf.borrow(frozen->buf.data(), frozen->buf.size());
+        }
+        return frozen;
+    }
+
+    // 공유 중인 payload 에 쓰기 전에 자기 버퍼를 갖는다. 다른 스냅숏이 없고 같은 풀의 버퍼 전체를 빌렸으면 복사 없이 되찾는다.
+    void unshare() {
+        if (!frozen) return;
+        // (payload 의 일부만 빌린 경우는 버퍼째 가져올 수 없으므로 복사한다)
+        if (frozen.use_count() == 1 && frozen->buf.resource() == buf.resource() &&
+            buf.data() == frozen->buf.data() && buf.size() == frozen->buf.size()) {
+            // 마지막 스냅숏이 다른 스레드에서 방금 해제됐을 수 있으므로 그 읽기가 끝난 뒤에 쓴다.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            buf = std::move(frozen->buf);
+        } else {
+            // Compact 는 곧 to_gap() 이 같은 버퍼에서 gap 을 열 수 있게 여유를 둔다.
+            CharBuffer own(buf.resource());
+            own.reserve(buf.size() + (is_compact() ? gap_reserve : 0));
+            own.append(buf.begin(), buf.end());
+            buf = std::move(own);
+        }
+        frozen.reset();
+    }
+
+    // 스냅숏의 payload 를 공유한 채로 내용으로 삼는다. (버전 checkout, 복사 없음)
+    // front/back 은 p 안의 두 구간이며(back 은 front 뒤), 그 사이는 gap 으로 본다. back 이 비어 있으면 Compact 다.
+    void adopt(std::shared_ptr<FrozenPayload> p, std::span<const char> front, std::span<const char> back) {
+        if (front.empty()) std::swap(front, back);
+        const char* first = front.data();
+        const char* last = back.empty() ? front.data() + front.size() : back.data() + back.size();
+        frozen = std::move(p);
+        buf.borrow(first, static_cast<size_t>(last - first));
+        gap_start = front.size();
+        gap_end = back.empty() ? buf.size() : static_cast<size_t>(back.data() - first);
+        len = front.size() + back.size();
+        mode = back.empty() ? Mode::Compact : Mode::Gap;
+    }
+
+    // s 를 그대로 담은 Compact 로 바꾼다.
+    void assign_compact(const char* first, const char* last) {
+        buf = CharBuffer(first, last, buf.resource());
+        frozen.reset();
+        set_compact_bounds();
+    }
+
+    // 빈 Gap (capacity 만큼 전부 gap, 최소 gap_reserve)
+    void assign_gap(size_t capacity = 0) {
+        if (capacity < gap_reserve) capacity = gap_reserve;
+        buf = CharBuffer(capacity, buf.resource());
+        frozen.reset();
+        mode = Mode::Gap;
+        len = 0;
+        gap_start = 0;
+        gap_end = capacity;
+    }
+
     // Gap 이동 (커서 이동)
     void move_gap(size_t target_logical_idx) {
+        unshare();   // insert/erase/split_right 도 여기를 거친다
         if (target_logical_idx == gap_start) return;
 
         char* ptr = buf.data(); // Raw pointer 획득
@@ -110,7 +509,7 @@ struct GapNode {
         }
     }
 
-    // 삽입 (Insert)
+    // 삽입 (Insert) - Gap 모드 전용
     void insert(size_t pos, std::string_view s) {
         move_gap(pos);
         
@@ -122,20 +521,52 @@ struct GapNode {
         // 데이터 복사 (반복문 대신 copy 사용)
         std::copy(s.begin(), s.end(), buf.begin() + gap_start);
         gap_start += s.size();
+        len += s.size();
     }
 
-    // 삭제 (Erase) - 핵심 기능 추가
-    void erase(size_t pos, size_t len) {
-        if (pos + len > size()) {
-             // 안전장치: 범위를 벗어나면 가능한 만큼만 삭제하거나 예외 처리
-             len = size() - pos; 
+    // 삭제 (Erase) - Gap 모드 전용
+    void erase(size_t pos, size_t count) {
+        if (pos + count > len) {
+             // 안전장치: 범위를 벗어나면 가능한 만큼만 삭제
+             count = len - pos; 
         }
         
         move_gap(pos); // 삭제할 위치 바로 앞으로 Gap 이동
         
         // Gap의 끝부분을 늘려서 데이터를 '삼킴' (논리적 삭제)
         // [A][Gap][B C D] -> delete 1 char (B) -> [A][Gap...][C D]
-        gap_end += len; 
+        gap_end += count; 
+        len -= count;
+    }
+
+    // 교체 (Replace) - Gap 모드 전용: [pos, pos + count) 를 s 로 바꾼다.
+    // gap 을 pos + count 로 한 번만 옮기고 gap_start 를 지울 바이트 위로 되돌려 gap 에 합친 뒤
+    // 그 자리에 바로 쓴다. 지울 바이트는 memmove 되지 않는다. (gap 이 모자랄 때만 확장)
+    void replace(size_t pos, size_t count, std::string_view s) {
+        if (pos + count > len) count = len - pos;
+        move_gap(pos + count);
+        gap_start -= count;
+        len -= count;
+
+        if (gap_end - gap_start < s.size()) {
+            expand_buffer(s.size());
+        }
+
+        std::copy(s.begin(), s.end(), buf.begin() + gap_start);
+        gap_start += s.size();
+        len += s.size();
+    }
+
+    // 뒤쪽을 잘라 앞 n 바이트만 남긴다. (모드 유지)
+    void truncate(size_t n) {
+        if (n >= len) return;
+        unshare();
+        if (is_compact()) {
+            buf.resize(n);
+            set_compact_bounds();
+        } else {
+            erase(n, len - n);
+        }
     }
 
     // 버퍼 확장
@@ -145,9 +576,9 @@ struct GapNode {
         const size_t used_back = old_cap - gap_end;
         const size_t used_bytes = used_front + used_back;
 
-        // 여유 공간을 크게 확보하여 연속적인 확장을 줄인다.
-        const size_t new_cap = std::max(old_cap * 2, used_bytes + needed + DEFAULT_GAP_SIZE);
-        std::vector<char> new_buf(new_cap);
+        // gap_reserve 만큼 여유를 두되, 사용량의 1/4 이상은 늘려서 반복 확장의 복사 비용을 상각한다.
+        const size_t new_cap = used_bytes + needed + std::max<size_t>(gap_reserve, used_bytes / 4);
+        CharBuffer new_buf(new_cap, buf.resource());
 
         // 앞부분 데이터 복사
         std::copy(buf.begin(), buf.begin() + used_front, new_buf.begin());
@@ -164,34 +595,66 @@ struct GapNode {
         gap_end = gap_start + (new_cap - used_bytes);
     }
 
-    // [최적화] 노드 분할을 위한 Suffix 추출 (string 변환 제거)
-    // 현재 노드에서 뒷부분(suffix_len 만큼)을 잘라내어 새 GapNode로 반환
-// [수정된 버전] GapNode::split_right
-    // 불필요한 메모리 낭비를 줄여 Read 속도를 회복합니다.
-    GapNode split_right(size_t suffix_len) {
-        size_t total_len = size(); // 현재 데이터 크기
-        size_t split_idx = total_len - suffix_len; // 분할 기준점 (prefix 길이)
+    // 1. Expand: Compact -> Gap (쓰기 모드 전환)
+    // 데이터 뒤에 gap 을 두어 [Data A B C][GAP . . .] 로 만든다.
+    // deletion 시에는 작은 gap, insertion 시에는 gap_reserve 만큼의 gap
+    void to_gap(bool for_deletion = false) {
+        unshare();
+        if (is_gap()) return;
+        if (is_pending()) {
+            // 아직 Gap 버퍼 그대로이므로 기존 버퍼를 재사용한다.
+            mode = Mode::Gap;
+            return;
+        }
+        // 남은 용량이 gap 으로 충분하면 재할당 없이 그대로 연다. (optimize() 가 용량을 남겨 둔 경우)
+        const size_t gap_pad = for_deletion ? 8 : gap_reserve;
+        buf.resize_for_overwrite(std::max(buf.capacity(), len + gap_pad));
+        mode = Mode::Gap;
+        gap_start = len;
+        gap_end = buf.size();
+    }
+
+    // 2. Compact: Gap -> Compact (읽기 모드 전환)
+    // 뒷부분을 memmove 로 당겨 같은 버퍼 안에서 Gap을 닫는다. 남는 용량이 작으면(compact_slack() 이하)
+    // 다음 to_gap() 을 위해 남겨 두고, 그보다 크면(gap 이 덜 찼거나 대량 삭제 후) 반납한다.
+    void to_compact() {
+        if (is_compact()) return;
+        unshare();
+        const size_t back = buf.size() - gap_end;
+        if (back) std::memmove(buf.data() + gap_start, buf.data() + gap_end, back);
+        buf.resize(len);
+        set_compact_bounds();
+        trim_slack();
+    }
+
+    // Compact 버퍼의 남는 용량이 compact_slack() 을 넘으면 반납한다. (병합으로 커진 버퍼 정리용)
+    void trim_slack() {
+        if (is_compact() && !frozen && buf.capacity() - len > compact_slack()) buf.shrink_to_fit();
+    }
+
+    // [최적화] 노드 분할을 위한 Suffix 추출 (string 변환 제거) - Gap 모드 전용
+    // 현재 노드에서 뒷부분(suffix_len 만큼)을 잘라내어 out 에 Gap 모드로 담는다.
+    // (out 은 모든 내용이 앞쪽에 있고 뒤가 전부 gap 인 상태가 된다)
+    void split_right(size_t suffix_len, NodeData& out) {
+        size_t split_idx = len - suffix_len; // 분할 기준점 (prefix 길이)
 
         // 1. Gap을 분할 지점으로 이동 (데이터 정렬)
         move_gap(split_idx);
         
-        // --- Right Node (새 노드) 생성 ---
+        // --- Right (새 노드) ---
         // 뒷부분 데이터를 가져갑니다.
-        GapNode new_node(suffix_len + DEFAULT_GAP_SIZE);
-        std::copy(buf.begin() + gap_end, buf.end(), new_node.buf.begin());
-        new_node.gap_start = suffix_len;
-        new_node.gap_end = new_node.buf.size();
-
-        // --- Left Node (현재 노드) 최적화 [중요!] ---
-        // 기존: gap_end = buf.size(); (용량은 그대로 둠 -> 메모리 낭비)
-        // 수정: 딱 맞는 크기의 새 버퍼로 교체합니다.
-        
+        out.gap_reserve = gap_reserve;
+        out.assign_gap(suffix_len + gap_reserve);
+        std::copy(buf.begin() + gap_end, buf.end(), out.buf.begin());
+        out.gap_start = suffix_len;
+        out.gap_end = out.buf.size();
+        out.len = suffix_len;
+
+        // --- Left (현재 노드) ---
+        // 용량을 그대로 두면 메모리가 낭비되므로 딱 맞는 크기의 새 버퍼로 교체합니다.
+        // Prefix용 새 버퍼 크기: 데이터 길이 + gap_reserve (편집 여유분)
         size_t prefix_len = split_idx;
-        // Prefix용 새 버퍼 크기: 데이터 길이 + 기본 Gap (편집 여유분)
-        // 만약 Read 위주라면 DEFAULT_GAP_SIZE를 더 작게 잡아도 됩니다.
-        size_t new_capacity = prefix_len + DEFAULT_GAP_SIZE;
-        
-        std::vector<char> new_buf(new_capacity);
+        CharBuffer new_buf(prefix_len + gap_reserve, buf.resource());
         
         // 현재 노드의 앞부분 데이터(prefix)만 복사
         std::copy(buf.begin(), buf.begin() + gap_start, new_buf.begin());
@@ -202,66 +665,77 @@ struct GapNode {
         // Gap 재설정
         gap_start = prefix_len;
         gap_end = buf.size(); // 끝까지 Gap
+        len = prefix_len;
+    }
+
+    // src 의 논리 내용을 앞(at_front) 또는 뒤에 붙인다. 모드(Gap/Compact)는 유지한다.
+    void merge(const NodeData& src, bool at_front) {
+        unshare();
+        const std::span<const char> f = src.front_span();
+        const std::span<const char> b = src.back_span();
+        if (is_compact()) {
+            if (at_front) {
+                CharBuffer merged(buf.resource());
+                merged.reserve(std::max(NODE_MAX_SIZE, len + src.len));
+                merged.append(f.data(), f.data() + f.size());
+                merged.append(b.data(), b.data() + b.size());
+                merged.append(buf.begin(), buf.end());
+                buf = std::move(merged);
+            } else {
+                buf.reserve(std::max(NODE_MAX_SIZE, len + src.len));
+                buf.append(f.data(), f.data() + f.size());
+                buf.append(b.data(), b.data() + b.size());
+            }
+            set_compact_bounds();
+            return;
+        }
 
-        return new_node;
+        const size_t at = at_front ? 0 : len;
+        insert(at, std::string_view(f.data(), f.size()));
+        insert(at + f.size(), std::string_view(b.data(), b.size()));
     }
+
     // 디버깅용
     std::string to_string() const {
         std::string res;
-        res.reserve(size());
+        res.reserve(len);
         res.append(buf.begin(), buf.begin() + gap_start);
         res.append(buf.begin() + gap_end, buf.end());
         return res;
     }
-};
-
-using NodeData = std::variant<GapNode, CompactNode>;
 
+private:
+    size_t compact_slack() const { return std::min(COMPACT_SLACK_LIMIT, len / COMPACT_SLACK_DIVISOR); }
 
-GapNode expand(const CompactNode& c, bool for_deletion = false) {
-    // deletion 시에는 작은 gap, insertion 시에는 넉넉한 gap
-    const size_t gap_pad = for_deletion ? 8 : DEFAULT_GAP_SIZE;
-    GapNode g(c.buf.size() + gap_pad);
-    
-    // 데이터 복사: CompactNode의 모든 데이터를 GapNode의 앞부분으로 복사
-    std::copy(c.buf.begin(), c.buf.end(), g.buf.begin());
-    
-    // Gap 설정: 데이터 바로 뒤부터 끝까지를 Gap으로 설정
-    // [Data A B C][GAP . . .]
-    g.gap_start = c.buf.size();
-    g.gap_end = g.buf.size();
-    
-    return g;
-}
-
-// 2. Compact: GapNode -> CompactNode (읽기 모드 전환)
-// 메모리 사용량을 줄이고 캐시 효율을 높이기 위해 Gap을 제거합니다.
-CompactNode compact(const GapNode& g) {
-    CompactNode c;
-    c.buf.reserve(g.size()); // 정확한 데이터 크기만큼만 예약
-
-    // Gap 앞부분 복사
-    c.buf.insert(c.buf.end(), g.buf.begin(), g.buf.begin() + g.gap_start);
-    
-    // Gap 뒷부분 복사
-    c.buf.insert(c.buf.end(), g.buf.begin() + g.gap_end, g.buf.end());
-    
-    // 불필요한 용량 제거
-    c.buf.shrink_to_fit(); 
-    
-    return c;
-}
+    void set_compact_bounds() {
+        mode = Mode::Compact;
+        len = buf.size();
+        gap_start = gap_end = len;
+    }
+};
 
 
 struct Node {
     NodeData data;
+    TextStats stats;        // 이 노드 내용의 집계값 (content_size()의 짝)
     
     // 외부에서는 기존처럼 배열로 접근
     Node** next;
     size_t* span;
+    TextStats* stat_span;   // span[] 과 같은 구간의 집계값
     int level;
-
-    Node(int lvl) : data(GapNode{}), next(nullptr), span(nullptr), level(lvl) {}
+    size_t index_slot = 0;  // 검색 인덱스(SearchIndex)에서의 위치 (1-based, 인덱스가 유효할 때만 의미 있음)
+    size_t dirty_slot = 0;  // 정리 대상 목록(dirty_nodes)에서의 위치 (1-based, 0 이면 목록에 없음)
+
+    // 적응형 모드 정책(maintain)용 접근 카운터. reads 는 스캔 API(scan/chunks/for_each_chunk)만 올리며,
+    // 이들은 const 이므로 mutable 이다. (임의 접근 at() 과 debug 검증은 세지 않는다)
+    // maintain() 이 방문할 때마다 절반으로 줄여 최근 접근이 더 크게 반영되게 한다.
+    mutable uint32_t reads = 0;
+    uint32_t writes = 0;
+
+    // 새 노드는 빈 Compact(할당 없음)로 시작한다. 호출자가 곧바로 내용을 채운다.
+    Node(int lvl, std::pmr::memory_resource* mr)
+        : data(mr), next(nullptr), span(nullptr), stat_span(nullptr), level(lvl) {}
     ~Node() = default;
 
     // Rule of Five 유지 (복사/이동 금지)
@@ -273,12 +747,12 @@ struct Node {
     void initialize_links(char* storage) {
         size_t next_size = sizeof(Node*) * level;
         size_t span_size = sizeof(size_t) * level;
+        size_t stat_size = sizeof(TextStats) * level;
         next = reinterpret_cast<Node**>(storage);
         span = reinterpret_cast<size_t*>(storage + next_size);
-        std::memset(storage, 0, next_size + span_size);
+        stat_span = reinterpret_cast<TextStats*>(storage + next_size + span_size);
+        std::memset(storage, 0, next_size + span_size + stat_size);
     }
 
-    size_t content_size() const {
-        return std::visit([](auto const& n) { return n.size(); }, data);
-    }
+    size_t content_size() const { return data.size(); }
 };
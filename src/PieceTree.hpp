@@ -0,0 +1,348 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+#include "Nodes.hpp"
+
+// --- Persistent Piece Tree ---
+// 스냅숏/버전의 내용을 나타내는 불변 트리. (경로 복사로 영속화한 treap)
+// - 트리 노드마다 piece 하나(FrozenPayload 안의 front/back 두 구간)를 가지며, 중위 순서가 문서 순서다.
+//   부분 트리의 바이트 수를 노드에 두어 위치 탐색은 O(depth) 이다.
+// - 노드는 만든 뒤 바꾸지 않는다. split/merge/replace 는 지나간 경로의 노드만 새로 만들고,
+//   나머지 부분 트리는 이전 트리와 shared_ptr 로 공유한다. (작은 편집 하나당 O(log n) 노드)
+// - 여러 스레드가 같은 트리를 동시에 읽어도 된다. 읽기는 참조 카운트를 건드리지 않는다.
+// - piece 를 자르면 두 조각이 원래 노드의 우선순위를 그대로 쓴다. (각 결과 트리의 루트가 되므로 힙 순서 유지)
+//   새 piece 의 우선순위만 호출자가 넘긴 SplitMix64 상태에서 뽑는다. (문서의 레벨 RNG 와 독립)
+class PieceTree {
+public:
+    struct Piece {
+        std::shared_ptr<const FrozenPayload> payload;   // front/back 이 가리키는 메모리의 소유권
+        std::span<const char> front;                    // 비어 있으면 back 도 비어 있다
+        std::span<const char> back;
+        TextStats stats;
+
+        size_t size() const { return front.size() + back.size(); }
+    };
+
+    PieceTree() = default;
+
+    size_t size() const { return root ? root->bytes : 0; }
+    bool empty() const { return !root; }
+    size_t piece_count() const { return root ? root->count : 0; }
+
+    // pos < size()
+    char at(size_t pos) const {
+        const Node* n = root.get();
+        while (true) {
+            const size_t lb = bytes(n->left.get());
+            if (pos < lb) {
+                n = n->left.get();
+                continue;
+            }
+            pos -= lb;
+            const Piece& p = n->piece;
+            if (pos < p.front.size()) return p.front[pos];
+            pos -= p.front.size();
+            if (pos < p.back.size()) return p.back[pos];
+            pos -= p.back.size();
+            n = n->right.get();
+        }
+    }
+
+    // [pos, pos + len) 을 청크(std::span<const char>) 단위로 방문한다. len 은 끝에서 잘린다.
+    template <typename Func>
+    void for_each_chunk(size_t pos, size_t len, Func func) const {
+        if (pos >= size()) return;
+        len = std::min(len, size() - pos);
+        visit_chunks(root.get(), pos, len, func);
+    }
+
+    // [pos, pos + len) 에 걸친 piece 를 순서대로 방문한다. 양 끝의 piece 는 범위에 맞게 잘라서 넘긴다.
+    template <typename Func>
+    void for_each_piece(size_t pos, size_t len, Func func) const {
+        if (pos >= size()) return;
+        len = std::min(len, size() - pos);
+        visit_pieces(root.get(), pos, len, func);
+    }
+
+    // piece 열로 트리를 만든다. (Cartesian tree 스택 구성, O(n)) 빈 piece 는 건너뛰며 원소는 move 된다.
+    static PieceTree build(std::span<Piece> pieces, uint64_t& rng) {
+        std::vector<std::shared_ptr<Node>> stack;
+        for (Piece& p : pieces) {
+            if (p.size() == 0) continue;
+            auto n = std::make_shared<Node>();
+            count_created();
+            n->piece = normalized(std::move(p));
+            n->priority = next_priority(rng);
+            std::shared_ptr<Node> last;
+            while (!stack.empty() && stack.back()->priority < n->priority) {
+                last = std::move(stack.back());
+                stack.pop_back();
+                pull(*last);
+            }
+            n->left = std::move(last);
+            if (!stack.empty()) stack.back()->right = n;
+            stack.push_back(std::move(n));
+        }
+        // 스택에 남은 오른쪽 척추는 위(깊은 쪽)부터 집계한다.
+        for (size_t i = stack.size(); i-- > 0;) pull(*stack[i]);
+        PieceTree t;
+        if (!stack.empty()) t.root = std::move(stack.front());
+        return t;
+    }
+
+    // [pos, pos + len) 을 with 로 바꾼 트리. (this 는 그대로)
+    PieceTree replace(size_t pos, size_t len, const PieceTree& with) const {
+        auto [left, rest] = split(root, pos);
+        auto [mid, right] = split(rest, len);
+        PieceTree t;
+        t.root = merge(merge(left, with.root), right);
+        return t;
+    }
+
+    // 두 트리의 앞(뒤)에서부터 같다고 보장되는 바이트 수.
+    // 같은 부분 트리 포인터는 통째로 건너뛰고, 나머지는 같은 메모리를 가리키는 청크를 겹치는 만큼 센다.
+    // (payload 는 불변이므로 같은 주소면 같은 내용이다) 바이트 비교는 하지 않으므로 실제 공통 부분보다 짧을 수 있다.
+    // 공유가 많은 두 버전이면 다른 경로 근처만 펼쳐 보므로 O(log n) 에 가깝다.
+    static size_t common_prefix(const PieceTree& a, const PieceTree& b) { return common<true>(a, b); }
+    static size_t common_suffix(const PieceTree& a, const PieceTree& b) { return common<false>(a, b); }
+
+#ifdef BIMODAL_DEBUG
+    // 지금까지 만든 트리 노드 수 (버전별 공유 테스트용)
+    static size_t debug_nodes_created() { return created.load(std::memory_order_relaxed); }
+#endif
+
+private:
+    struct Node {
+        std::shared_ptr<const Node> left;
+        std::shared_ptr<const Node> right;
+        Piece piece;
+        uint64_t priority = 0;
+        size_t bytes = 0;   // 부분 트리의 바이트 수
+        size_t count = 0;   // 부분 트리의 piece 수
+    };
+    using Ptr = std::shared_ptr<const Node>;
+
+    Ptr root;
+
+#ifdef BIMODAL_DEBUG
+    static inline std::atomic<size_t> created{0};
+    static void count_created() { created.fetch_add(1, std::memory_order_relaxed); }
+#else
+    static void count_created() {}
+#endif
+
+    static size_t bytes(const Node* n) { return n ? n->bytes : 0; }
+    static size_t count(const Node* n) { return n ? n->count : 0; }
+
+    static void pull(Node& n) {
+        n.bytes = bytes(n.left.get()) + n.piece.size() + bytes(n.right.get());
+        n.count = count(n.left.get()) + 1 + count(n.right.get());
+    }
+
+    static uint64_t next_priority(uint64_t& rng) {
+        uint64_t z = (rng += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // front 가 비어 있고 back 만 있으면 back 을 front 로 옮긴다.
+    static Piece normalized(Piece p) {
+        if (p.front.empty()) std::swap(p.front, p.back);
+        return p;
+    }
+
+    static Ptr make(Ptr left, Piece piece, uint64_t priority, Ptr right) {
+        auto n = std::make_shared<Node>();
+        count_created();
+        n->left = std::move(left);
+        n->right = std::move(right);
+        n->piece = std::move(piece);
+        n->priority = priority;
+        pull(*n);
+        return n;
+    }
+
+    // piece 를 앞 k 바이트와 나머지로 자른다. (0 < k < size) 집계값은 작은 쪽만 세고 나머지는 뺄셈으로 구한다.
+    static std::pair<Piece, Piece> cut(const Piece& p, size_t k) {
+        Piece a{p.payload, {}, {}, {}};
+        Piece b{p.payload, {}, {}, {}};
+        const size_t f = p.front.size();
+        if (k <= f) {
+            a.front = p.front.first(k);
+            b.front = p.front.subspan(k);
+            b.back = p.back;
+        } else {
+            a.front = p.front;
+            a.back = p.back.first(k - f);
+            b.front = p.back.subspan(k - f);
+        }
+        b = normalized(std::move(b));
+        if (k <= p.size() / 2) {
+            a.stats = measure(a.front) + measure(a.back);
+            b.stats = p.stats - a.stats;
+        } else {
+            b.stats = measure(b.front) + measure(b.back);
+            a.stats = p.stats - b.stats;
+        }
+        return {std::move(a), std::move(b)};
+    }
+
+    // 앞 pos 바이트와 나머지로 나눈다. pos 가 piece 중간이면 piece 를 잘라 두 노드가 같은 우선순위를 갖는다.
+    static std::pair<Ptr, Ptr> split(const Ptr& t, size_t pos) {
+        if (!t) return {};
+        if (pos == 0) return {nullptr, t};
+        if (pos >= t->bytes) return {t, nullptr};
+        const size_t lb = bytes(t->left.get());
+        if (pos <= lb) {
+            auto [a, b] = split(t->left, pos);
+            return {std::move(a), make(std::move(b), t->piece, t->priority, t->right)};
+        }
+        const size_t pe = lb + t->piece.size();
+        if (pos >= pe) {
+            auto [a, b] = split(t->right, pos - pe);
+            return {make(t->left, t->piece, t->priority, std::move(a)), std::move(b)};
+        }
+        auto [pa, pb] = cut(t->piece, pos - lb);
+        return {make(t->left, std::move(pa), t->priority, nullptr),
+                make(nullptr, std::move(pb), t->priority, t->right)};
+    }
+
+    static Ptr merge(const Ptr& a, const Ptr& b) {
+        if (!a) return b;
+        if (!b) return a;
+        if (a->priority >= b->priority) return make(a->left, a->piece, a->priority, merge(a->right, b));
+        return make(merge(a, b->left), b->piece, b->priority, b->right);
+    }
+
+    // n 의 부분 트리를 off 부터 len 바이트 방문한다. len 을 다 쓰면 false.
+    template <typename Func>
+    static bool visit_chunks(const Node* n, size_t off, size_t& len, Func& func) {
+        if (!n) return true;
+        const size_t lb = bytes(n->left.get());
+        if (off < lb) {
+            if (!visit_chunks(n->left.get(), off, len, func)) return false;
+            off = 0;
+        } else {
+            off -= lb;
+        }
+        for (std::span<const char> part : {n->piece.front, n->piece.back}) {
+            if (off >= part.size()) {
+                off -= part.size();
+                continue;
+            }
+            const size_t take = std::min(part.size() - off, len);
+            func(part.subspan(off, take));
+            len -= take;
+            off = 0;
+            if (len == 0) return false;
+        }
+        return visit_chunks(n->right.get(), off, len, func);
+    }
+
+    template <typename Func>
+    static bool visit_pieces(const Node* n, size_t off, size_t& len, Func& func) {
+        if (!n) return true;
+        const size_t lb = bytes(n->left.get());
+        if (off < lb) {
+            if (!visit_pieces(n->left.get(), off, len, func)) return false;
+            off = 0;
+        } else {
+            off -= lb;
+        }
+        const size_t ps = n->piece.size();
+        if (off < ps) {
+            const size_t take = std::min(ps - off, len);
+            if (off == 0 && take == ps) {
+                func(n->piece);
+            } else {
+                Piece p = off ? cut(n->piece, off).second : n->piece;
+                if (take < p.size()) p = cut(p, take).first;
+                func(p);
+            }
+            len -= take;
+            if (len == 0) return false;
+            off = 0;
+        } else {
+            off -= ps;
+        }
+        return visit_pieces(n->right.get(), off, len, func);
+    }
+
+    // common_prefix/common_suffix 의 진행 상태: 아직 비교하지 않은 항목(부분 트리 또는 청크)의 스택.
+    // Forward 이면 맨 위가 가장 앞 항목, 아니면 가장 뒤 항목이다.
+    struct Item {
+        const Node* node;    // nullptr 이면 [ptr, ptr + len) 청크
+        const char* ptr;
+        size_t len;
+    };
+
+    template <bool Forward>
+    static void expand(std::vector<Item>& stack) {
+        const Node* n = stack.back().node;
+        stack.pop_back();
+        auto push_node = [&](const Ptr& c) {
+            if (c) stack.push_back({c.get(), nullptr, c->bytes});
+        };
+        auto push_chunk = [&](std::span<const char> s) {
+            if (!s.empty()) stack.push_back({nullptr, s.data(), s.size()});
+        };
+        if constexpr (Forward) {
+            push_node(n->right);
+            push_chunk(n->piece.back);
+            push_chunk(n->piece.front);
+            push_node(n->left);
+        } else {
+            push_node(n->left);
+            push_chunk(n->piece.front);
+            push_chunk(n->piece.back);
+            push_node(n->right);
+        }
+    }
+
+    template <bool Forward>
+    static size_t common(const PieceTree& a, const PieceTree& b) {
+        std::vector<Item> sa, sb;
+        if (a.root) sa.push_back({a.root.get(), nullptr, a.root->bytes});
+        if (b.root) sb.push_back({b.root.get(), nullptr, b.root->bytes});
+        size_t matched = 0;
+        while (!sa.empty() && !sb.empty()) {
+            Item& x = sa.back();
+            Item& y = sb.back();
+            if (x.node && x.node == y.node) {
+                matched += x.len;
+                sa.pop_back();
+                sb.pop_back();
+                continue;
+            }
+            if (x.node || y.node) {
+                // 부분 트리 쪽(둘 다면 큰 쪽)을 한 단계 펼친다.
+                if (x.node && (!y.node || x.len >= y.len)) {
+                    expand<Forward>(sa);
+                } else {
+                    expand<Forward>(sb);
+                }
+                continue;
+            }
+            const bool same = Forward ? x.ptr == y.ptr : x.ptr + x.len == y.ptr + y.len;
+            if (!same) break;
+            const size_t n = std::min(x.len, y.len);
+            matched += n;
+            if constexpr (Forward) {
+                x.ptr += n;
+                y.ptr += n;
+            }
+            x.len -= n;
+            y.len -= n;
+            if (x.len == 0) sa.pop_back();
+            if (y.len == 0) sb.pop_back();
+        }
+        return matched;
+    }
+};
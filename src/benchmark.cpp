@@ -35,6 +35,7 @@ using namespace std;
 using namespace std::chrono;
 
 constexpr int SCENARIO_REPEATS = 10;
+constexpr uint64_t BIMODAL_SEED = 12345;  // BiModalText 레벨 RNG 시드 (실행 간 재현성)
 
 // Global filters for selective runs
 static char g_scenario_filter = '\0'; // 'a'..'g' or 0 for all
@@ -245,7 +246,7 @@ TypingStats bench_rope_once() {
 #endif
 
 TypingStats bench_bimodal_once() {
-    BiModalText bmt;
+    BiModalText bmt(BIMODAL_SEED);
     for(int i=0; i<INITIAL_SIZE/1000; ++i) bmt.insert(bmt.size(), string(1000, 'x'));
 
     Timer t;
@@ -391,7 +392,7 @@ void bench_mixed_workload() {
 
     if (allow_struct("BiModalText")) {
         auto best = run_best_of([&]() {
-            BiModalText bmt;
+            BiModalText bmt(BIMODAL_SEED);
             string chunk(1000, 'x');
             for(int i=0; i<N/1000; ++i) bmt.insert(0, chunk);
             bmt.optimize();
@@ -630,7 +631,7 @@ void bench_random_access() {
         auto best = run_best_of([&]() {
             mt19937 local_gen = gen;
             auto local_dist = dist;
-            BiModalText bmt;
+            BiModalText bmt(BIMODAL_SEED);
             for(int i=0; i<TEST_SIZE/1000; ++i) bmt.insert(0, string(1000, 'x'));
 
             Timer edit_timer;
@@ -723,7 +724,7 @@ void bench_heavy_typer() {
 
     if (allow_struct("BiModalText")) {
         auto best = run_best_of([&]() {
-            BiModalText bmt;
+            BiModalText bmt(BIMODAL_SEED);
             bmt.insert(0, std::string(LARGE_SIZE, 'x'));
             bmt.optimize(); // 준비 단계에서 정리
             Timer t;
@@ -734,6 +735,17 @@ void bench_heavy_typer() {
         if (allow_struct("BiModalText")) {
             cout << left << setw(18) << "BiModalText" << setw(15) << best << "(Skiplist + gap split)" << endl;
         }
+
+        auto best_cursor = run_best_of([&]() {
+            BiModalText bmt(BIMODAL_SEED);
+            bmt.insert(0, std::string(LARGE_SIZE, 'x'));
+            bmt.optimize();
+            Timer t;
+            BiModalText::Cursor cur = bmt.cursor(bmt.size() / 2);
+            for(int i=0; i<HEAVY_INSERTS; ++i) cur.insert_here("A");
+            return t.elapsed_ms();
+        });
+        cout << left << setw(18) << "BiModalText/Cur" << setw(15) << best_cursor << "(Cached find_node path)" << endl;
     }
 }
 
@@ -812,7 +824,7 @@ void bench_paster() {
 
     if (allow_struct("BiModalText")) {
         auto best = run_best_of([&]() {
-            BiModalText bmt;
+            BiModalText bmt(BIMODAL_SEED);
             bmt.insert(0, string(INIT_SIZE, 'x'));
             Timer t;
             size_t pos = bmt.size() / 2;
@@ -825,6 +837,43 @@ void bench_paster() {
     }
 }
 
+// Scenario G: 편집마다 publish() 하는 쓰기 스레드. (언어 서버가 프레임마다 공개본을 받는 경우)
+// publish() 는 증분 snapshot() 이므로 편집 하나당 비용은 바뀐 노드 몇 개의 동결 + piece 트리 경로 O(log n) 이고,
+// 공개된 노드에 다시 쓰는 첫 편집은 그 노드 하나를 copy-on-write 로 복사한다.
+void bench_publisher() {
+    if (!scenario_enabled('g') || !allow_struct("BiModalText")) return;
+    const size_t DOC_SIZE = 10ull * 1024 * 1024; // 10MB
+    const int EDITS = 1000;
+
+    cout << "\n[Scenario G: The Publisher (best of "
+         << SCENARIO_REPEATS << ")]" << endl;
+    cout << "  - N=" << (DOC_SIZE / 1024 / 1024) << "MB, Random inserts=" << EDITS << ", publish() after each" << endl;
+    cout << "--------------------------------------------------------------" << endl;
+    cout << left << setw(18) << "Structure" << setw(15) << "Time (ms)" << "Note" << endl;
+    cout << "--------------------------------------------------------------" << endl;
+
+    const string doc(DOC_SIZE, 'x');
+    auto run = [&](bool publish) {
+        return run_best_of([&]() {
+            BiModalText bmt(doc, BIMODAL_SEED);
+            bmt.publish();
+            mt19937 gen(77);
+            Timer t;
+            for (int i = 0; i < EDITS; ++i) {
+                bmt.insert(gen() % bmt.size(), "A");
+                if (publish) bmt.publish();
+            }
+            return t.elapsed_ms();
+        });
+    };
+    const double edit_only = run(false);
+    const double with_publish = run(true);
+    cout << left << setw(18) << "BiModalText" << setw(15) << edit_only << "(Edits only)" << endl;
+    cout << left << setw(18) << "BiModalText/Pub" << setw(15) << with_publish
+         << "(+" << fixed << setprecision(2) << (with_publish - edit_only) * 1000.0 / EDITS
+         << " us per publish)" << defaultfloat << endl;
+}
+
 int main(int argc, char** argv) {
     if (argc >= 2) {
         string arg1 = argv[1];
@@ -851,6 +900,7 @@ int main(int argc, char** argv) {
     bench_mixed_workload(); // D (now refactorer)
     bench_random_access(); // E
     bench_paster();        // F
+    bench_publisher();     // G
     if (dummy_checksum == 123456789) cout << ""; 
     return 0;
 }
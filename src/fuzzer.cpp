@@ -1,9 +1,15 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
 #include <random>
+#include <span>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "BiModalSkipList.hpp"
@@ -99,6 +105,37 @@ void check_equal(const string& ref, const BiModalText& txt,
         }
 
         mt19937 rng(123456);
+        for (int k = 0; k < 4; ++k) {
+            size_t pos = rng() % (ref.size() + 1);
+            size_t len = rng() % (NODE_MAX_SIZE * 2);
+            if (txt.substr(pos, len) != ref.substr(pos, len)) {
+                cerr << "[FAIL] substr(" << pos << ", " << len << ") mismatch at "
+                     << where << " step=" << step << " seed=" << seed << "\n";
+#ifdef BIMODAL_DEBUG
+                txt.debug_verify_spans(cerr);
+                txt.debug_dump_structure(cerr);
+#endif
+                std::exit(1);
+            }
+        }
+
+        {
+            size_t pos = rng() % ref.size();
+            string via_chunks;
+            bool non_empty = true;
+            txt.for_each_chunk(pos, ref.size(), [&](span<const char> chunk) {
+                if (chunk.empty()) non_empty = false;
+                via_chunks.append(chunk.data(), chunk.size());
+            });
+            string via_range;
+            for (span<const char> chunk : txt.chunks()) via_range.append(chunk.data(), chunk.size());
+            if (!non_empty || via_chunks != ref.substr(pos) || via_range != ref) {
+                cerr << "[FAIL] for_each_chunk(" << pos << ") mismatch at "
+                     << where << " step=" << step << " seed=" << seed << "\n";
+                std::exit(1);
+            }
+        }
+
         for (int k = 0; k < 10 && ref.size() > 1; ++k) {
             size_t pos = rng() % ref.size();
             char a = txt.at(pos);
@@ -186,8 +223,10 @@ void split_merge_stress_test() {
     cout << "  \u2713 split/merge stress test passed\n";
 }
 
-void random_edit_test(int seed, int ops) {
+void random_edit_test(int seed, int ops, bool eager_rebalance = false, bool lazy_compaction = false) {
     BiModalText txt;
+    txt.set_eager_rebalance(eager_rebalance);
+    txt.set_lazy_compaction(lazy_compaction);
     string ref;
 
     mt19937 rng(seed);
@@ -232,6 +271,99 @@ void random_edit_test(int seed, int ops) {
     check_equal(ref, txt, "random/final", ops, seed);
 
     cout << "  \u2713 random test seed=" << seed
+         << " ops=" << ops << (eager_rebalance ? " (eager)" : "")
+         << (lazy_compaction ? " (lazy)" : "") << " passed\n";
+}
+
+// 노드 크기를 넘나드는 삽입(붙여넣기 런 경로)과 작은 삭제를 섞는다.
+void random_paste_test(int seed, int ops) {
+    BiModalText txt;
+    string ref;
+
+    mt19937 rng(seed);
+    uniform_int_distribution<int> op_dist(0, 9);
+    uniform_int_distribution<size_t> len_dist(1000, NODE_MAX_SIZE * 3);
+
+    for (int step = 0; step < ops; ++step) {
+        int op = op_dist(rng);
+
+        if (op <= 4) {
+            size_t pos = ref.empty() ? 0 : (rng() % (ref.size() + 1));
+            string s(len_dist(rng), static_cast<char>('a' + rng() % 26));
+            txt.insert(pos, s);
+            ref.insert(pos, s);
+            check_equal(ref, txt, "paste/insert", step, seed);
+            assert(txt.debug_max_node_size() <= NODE_MAX_SIZE);
+        } else if (op <= 8) {
+            if (!ref.empty()) {
+                size_t pos = rng() % ref.size();
+                size_t len = min<size_t>(1 + rng() % 2000, ref.size() - pos);
+                txt.erase(pos, len);
+                ref.erase(pos, len);
+                check_equal(ref, txt, "paste/erase", step, seed);
+            }
+        } else {
+            txt.optimize();
+            check_equal(ref, txt, "paste/optimize", step, seed);
+        }
+    }
+
+    cout << "  \u2713 paste test seed=" << seed
+         << " ops=" << ops << " passed\n";
+}
+
+void cursor_edit_test(int seed, int ops) {
+    BiModalText txt;
+    string ref;
+    BiModalText::Cursor cur = txt.cursor();
+
+    mt19937 rng(seed);
+    uniform_int_distribution<int> op_dist(0, 9);
+    uniform_int_distribution<int> ch_dist(0, 25);
+
+    for (int step = 0; step < ops; ++step) {
+        int op = op_dist(rng);
+        size_t pos = cur.position();
+
+        if (op <= 4) {
+            // 타이핑: 같은 자리에서 연속 삽입
+            string s(1 + rng() % 8, static_cast<char>('a' + ch_dist(rng)));
+            cur.insert_here(s);
+            ref.insert(pos, s);
+            assert(cur.position() == pos + s.size());
+        } else if (op == 5) {
+            // 백스페이스
+            if (pos > 0) {
+                cur.move_by(-1);
+                cur.erase_here(1);
+                ref.erase(pos - 1, 1);
+            }
+        } else if (op == 6) {
+            size_t len = 1 + rng() % 16;
+            cur.erase_here(len);
+            if (pos < ref.size()) ref.erase(pos, min(len, ref.size() - pos));
+        } else if (op == 7) {
+            long delta = static_cast<long>(rng() % 64) - 32;
+            size_t target = static_cast<size_t>(min<long>(max<long>(0, static_cast<long>(pos) + delta),
+                                                          static_cast<long>(ref.size())));
+            cur.move_to(target);
+            if (target < ref.size() && cur.get() != ref[target]) {
+                cerr << "[FAIL] cursor get mismatch step=" << step << " seed=" << seed << "\n";
+                std::exit(1);
+            }
+        } else if (op == 8) {
+            // 커서 밖에서의 편집은 캐시를 무효화해야 한다.
+            size_t p = rng() % (ref.size() + 1);
+            txt.insert(p, "ZZ");
+            ref.insert(p, "ZZ");
+            if (p <= pos) cur.move_to(pos + 2);
+        } else {
+            txt.optimize();
+        }
+        check_equal(ref, txt, "cursor/step", step, seed);
+    }
+
+    cout << "  \u2713 cursor test seed=" << seed
          << " ops=" << ops << " passed\n";
 }
 
@@ -242,6 +374,10 @@ void run_regression_suite() {
     random_edit_test(1, 2000);
     random_edit_test(2, 2000);
     random_edit_test(3, 2000);
+    random_edit_test(4, 2000, true);
+    random_edit_test(6, 2000, false, true);
+    random_paste_test(7, 300);
+    cursor_edit_test(5, 3000);
     cout << "\u2713 Testing regression suite passed\n";
 }
 
@@ -576,11 +712,1033 @@ void test_optimize_with_tiny_nodes() {
     cout << "\u2713 Tiny node merge test passed\n";
 }
 
+void test_bulk_load() {
+    cout << "\n[BULK TEST] assign()/constructor bulk load...\n";
+
+    mt19937 rng(7);
+    string ref(NODE_MAX_SIZE * 37 + 11, '\0');
+    for (char& c : ref) c = static_cast<char>('a' + rng() % 26);
+
+    BiModalText txt(ref);
+    assert(txt.debug_verify_spans());
+    check_equal(ref, txt, "bulk/ctor", 0, 7);
+
+    txt.insert(ref.size() / 2, "MID");
+    ref.insert(ref.size() / 2, "MID");
+    txt.erase(100, NODE_MAX_SIZE * 2);
+    ref.erase(100, NODE_MAX_SIZE * 2);
+    check_equal(ref, txt, "bulk/edit", 0, 7);
+
+    txt.assign("short");
+    check_equal("short", txt, "bulk/reassign", 0, 7);
+
+    txt.assign("");
+    check_equal("", txt, "bulk/empty", 0, 7);
+
+    cout << "\u2713 Bulk load test passed\n";
+}
+
+void test_large_paste() {
+    cout << "\n[PASTE TEST] Oversized inserts split into sized runs...\n";
+
+    BiModalText txt;
+    string ref;
+    string base(NODE_MAX_SIZE * 5, 'x');
+    txt.insert(0, base);
+    ref.insert(0, base);
+
+    string big(NODE_MAX_SIZE * 20 + 77, 'P');
+    const size_t positions[] = {0, 1, NODE_MAX_SIZE + 3, ref.size() / 2, ref.size()};
+    for (size_t p : positions) {
+        size_t pos = min(p, ref.size());
+        txt.insert(pos, big);
+        ref.insert(pos, big);
+        check_equal(ref, txt, "paste/insert", static_cast<int>(pos), 0);
+        assert(txt.debug_verify_spans());
+        assert(txt.debug_max_node_size() <= NODE_MAX_SIZE);
+    }
+
+    txt.optimize();
+    txt.insert(ref.size() / 3, big);
+    ref.insert(ref.size() / 3, big);
+    check_equal(ref, txt, "paste/after-optimize", 0, 0);
+    assert(txt.debug_max_node_size() <= NODE_MAX_SIZE);
+
+    BiModalText empty;
+    empty.insert(0, big);
+    check_equal(big, empty, "paste/empty", 0, 0);
+
+    cout << "\u2713 Large paste test passed\n";
+}
+
+void test_defragment() {
+    cout << "\n[DEFRAG TEST] optimize() coalesces underfull nodes...\n";
+
+    string ref(NODE_MAX_SIZE * 64, '\0');
+    for (size_t i = 0; i < ref.size(); ++i) ref[i] = static_cast<char>('a' + i % 26);
+    BiModalText txt(ref);
+
+    // 노드마다 거의 전부를 지워서 아주 작은 노드들만 남긴다.
+    for (size_t node = 64; node-- > 0;) {
+        size_t pos = node * NODE_MAX_SIZE + 7;
+        txt.erase(pos, NODE_MAX_SIZE - 10);
+        ref.erase(pos, NODE_MAX_SIZE - 10);
+    }
+    check_equal(ref, txt, "defrag/fragmented", 0, 0);
+    size_t before = txt.debug_node_count();
+
+    txt.optimize();
+    assert(txt.debug_verify_spans());
+    check_equal(ref, txt, "defrag/optimized", 0, 0);
+    assert(txt.debug_node_count() < before);
+    assert(txt.debug_node_count() == 1);
+    assert(txt.debug_compact_slack() <= txt.size() / NodeData::COMPACT_SLACK_DIVISOR);
+
+    txt.insert(ref.size() / 2, "XYZ");
+    ref.insert(ref.size() / 2, "XYZ");
+    check_equal(ref, txt, "defrag/edit", 0, 0);
+
+    cout << "\u2713 Defragment test passed\n";
+}
+
+void test_eager_rebalance() {
+    cout << "\n[EAGER TEST] erase() rebalances underfull nodes...\n";
+
+    string ref(NODE_MAX_SIZE * 64, '\0');
+    for (size_t i = 0; i < ref.size(); ++i) ref[i] = static_cast<char>('a' + i % 26);
+    BiModalText txt(ref);
+    txt.set_eager_rebalance(true);
+
+    for (size_t node = 64; node-- > 0;) {
+        size_t pos = node * NODE_MAX_SIZE + 7;
+        txt.erase(pos, NODE_MAX_SIZE - 10);
+        ref.erase(pos, NODE_MAX_SIZE - 10);
+    }
+    assert(txt.debug_verify_spans());
+    check_equal(ref, txt, "eager/fragmented", 0, 0);
+    assert(txt.debug_node_count() == 1);
+
+    // 이웃이 커서 병합할 수 없으면 차용으로 양쪽을 고르게 만든다.
+    BiModalText big(string(NODE_MAX_SIZE * 2, 'q'));
+    string big_ref(NODE_MAX_SIZE * 2, 'q');
+    big.set_eager_rebalance(true);
+    big.erase(0, NODE_MAX_SIZE - 5);
+    big_ref.erase(0, NODE_MAX_SIZE - 5);
+    assert(big.debug_node_count() == 2);
+    assert(big.debug_max_node_size() < NODE_MAX_SIZE);
+    big.erase(big_ref.size() - 3, 3);
+    big_ref.erase(big_ref.size() - 3, 3);
+    assert(big.debug_verify_spans());
+    check_equal(big_ref, big, "eager/borrow", 0, 0);
+
+    cout << "\u2713 Eager rebalance test passed\n";
+}
+
+void test_finger_locality() {
+    cout << "\n[FINGER TEST] Local at()/edits reuse the cached search path...\n";
+
+    mt19937 rng(11);
+    string ref(NODE_MAX_SIZE * 200, '\0');
+    for (char& c : ref) c = static_cast<char>('a' + rng() % 26);
+    BiModalText txt(ref);
+
+    size_t p = 0;
+    for (int step = 0; step < 4000; ++step) {
+        // 구문 강조기처럼 p, p+1, p+40 근처를 읽고, 가끔 그 자리를 편집한다.
+        const size_t probes[] = {p, p + 1, p + 40, p > 3 ? p - 3 : 0};
+        for (size_t q : probes) {
+            if (q < ref.size() && txt.at(q) != ref[q]) {
+                cerr << "[FAIL] finger at(" << q << ") mismatch step=" << step << "\n";
+                std::exit(1);
+            }
+        }
+        if (step % 7 == 0) {
+            txt.insert(p, "fg");
+            ref.insert(p, "fg");
+        } else if (step % 11 == 0 && p + 5 < ref.size()) {
+            txt.erase(p, 5);
+            ref.erase(p, 5);
+        }
+        p = (p + 1 + rng() % 300) % ref.size();
+    }
+    assert(txt.debug_verify_spans());
+    check_equal(ref, txt, "finger/final", 0, 11);
+
+    cout << "\u2713 Finger locality test passed\n";
+}
+
+void test_line_index() {
+    cout << "\n[LINE TEST] line_count / offset_to_line / line_to_offset...\n";
+
+    mt19937 rng(21);
+    string ref;
+    BiModalText txt;
+    assert(txt.line_count() == 1 && txt.offset_to_line(0) == 0 && txt.line_to_offset(0) == 0);
+
+    auto verify = [&](int step) {
+        vector<size_t> starts = {0};
+        vector<size_t> line_of(ref.size() + 1, 0);
+        for (size_t i = 0; i < ref.size(); ++i) {
+            if (ref[i] == '\n') starts.push_back(i + 1);
+            line_of[i + 1] = starts.size() - 1;
+        }
+        if (txt.line_count() != starts.size()) {
+            cerr << "[FAIL] line_count mismatch step=" << step << "\n";
+            std::exit(1);
+        }
+        for (size_t k = 0; k < 8; ++k) {
+            size_t line = rng() % starts.size();
+            size_t pos = rng() % (ref.size() + 1);
+            if (txt.line_to_offset(line) != starts[line] || txt.offset_to_line(pos) != line_of[pos]) {
+                cerr << "[FAIL] line index mismatch step=" << step << " line=" << line
+                     << " pos=" << pos << "\n";
+                std::exit(1);
+            }
+        }
+    };
+
+    for (int step = 0; step < 1500; ++step) {
+        int op = rng() % 10;
+        if (op <= 5) {
+            // 짧은 줄 여러 개 또는 가끔 노드보다 큰 붙여넣기
+            size_t len = (step % 40 == 0) ? NODE_MAX_SIZE + rng() % NODE_MAX_SIZE : 1 + rng() % 64;
+            string s(len, 'x');
+            for (char& c : s) c = (rng() % 8 == 0) ? '\n' : static_cast<char>('a' + rng() % 26);
+            size_t pos = ref.empty() ? 0 : rng() % (ref.size() + 1);
+            txt.insert(pos, s);
+            ref.insert(pos, s);
+        } else if (op <= 8) {
+            if (!ref.empty()) {
+                size_t pos = rng() % ref.size();
+                size_t len = min<size_t>(1 + rng() % 300, ref.size() - pos);
+                txt.erase(pos, len);
+                ref.erase(pos, len);
+            }
+        } else {
+            txt.optimize();
+        }
+        verify(step);
+    }
+    assert(txt.debug_verify_spans());
+    check_equal(ref, txt, "line/final", 0, 21);
+
+    txt.assign(ref);
+    verify(-1);
+    assert(txt.debug_verify_spans());
+
+    bool threw = false;
+    try { txt.line_to_offset(txt.line_count()); } catch (const std::out_of_range&) { threw = true; }
+    assert(threw);
+
+    cout << "\u2713 Line index test passed\n";
+}
+
+static string encode_utf8(const u32string& cps) {
+    string out;
+    for (char32_t c : cps) {
+        if (c < 0x80) {
+            out.push_back(static_cast<char>(c));
+        } else if (c < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+    }
+    return out;
+}
+
+void test_utf8_mode() {
+    cout << "\n[UTF-8 TEST] Codepoint / UTF-16 positions and split boundaries...\n";
+
+    mt19937 rng(31);
+    // 1 ~ 4 바이트 코드포인트를 섞는다.
+    const char32_t samples[] = {U'a', U'\n', U'\u00e9', U'\u03bb', U'\ud55c', U'\u4e2d', U'\U0001F600', U'\U00010348'};
+    auto random_text = [&](size_t n) {
+        u32string t(n, U'a');
+        for (char32_t& c : t) c = samples[rng() % 8];
+        return t;
+    };
+
+    u32string ref;
+    BiModalText txt;
+    txt.set_utf8_mode(true);
+    txt.set_eager_rebalance(true);
+
+    auto verify = [&](int step) {
+        size_t u16 = 0;
+        for (char32_t c : ref) u16 += c >= 0x10000 ? 2 : 1;
+        if (txt.codepoint_count() != ref.size() || txt.utf16_count() != u16) {
+            cerr << "[FAIL] utf8 counts mismatch step=" << step << "\n";
+            std::exit(1);
+        }
+        // 노드 경계(청크 시작)는 항상 코드포인트 경계여야 한다.
+        txt.for_each_chunk(0, txt.size(), [&](std::span<const char> c) {
+            if (!c.empty() && (static_cast<unsigned char>(c[0]) & 0xC0) == 0x80) {
+                cerr << "[FAIL] chunk starts inside a multibyte sequence step=" << step << "\n";
+                std::exit(1);
+            }
+        });
+        vector<size_t> offs(ref.size() + 1, 0), units(ref.size() + 1, 0);
+        for (size_t j = 0; j < ref.size(); ++j) {
+            offs[j + 1] = offs[j] + (ref[j] < 0x80 ? 1 : ref[j] < 0x800 ? 2 : ref[j] < 0x10000 ? 3 : 4);
+            units[j + 1] = units[j] + (ref[j] >= 0x10000 ? 2 : 1);
+        }
+        for (int k = 0; k < 8 && !ref.empty(); ++k) {
+            size_t cp = rng() % ref.size();
+            if (txt.codepoint_at(cp) != ref[cp] || txt.codepoint_to_offset(cp) != offs[cp] ||
+                txt.offset_to_codepoint(offs[cp]) != cp) {
+                cerr << "[FAIL] codepoint index mismatch step=" << step << " cp=" << cp << "\n";
+                std::exit(1);
+            }
+            if (txt.offset_to_utf16(offs[cp]) != units[cp] || txt.utf16_to_offset(units[cp]) != offs[cp] ||
+                (ref[cp] >= 0x10000 && txt.utf16_to_offset(units[cp] + 1) != offs[cp])) {
+                cerr << "[FAIL] utf16 index mismatch step=" << step << " cp=" << cp << "\n";
+                std::exit(1);
+            }
+        }
+    };
+
+    for (int step = 0; step < 1000; ++step) {
+        int op = rng() % 10;
+        if (op <= 5) {
+            u32string t = random_text(step % 30 == 0 ? 1500 + rng() % 3000 : 1 + rng() % 40);
+            size_t cp = ref.empty() ? 0 : rng() % (ref.size() + 1);
+            txt.insert_at_codepoint(cp, encode_utf8(t));
+            ref.insert(cp, t);
+        } else if (op <= 8) {
+            if (!ref.empty()) {
+                size_t cp = rng() % ref.size();
+                size_t n = min<size_t>(1 + rng() % 200, ref.size() - cp);
+                txt.erase_codepoints(cp, n);
+                ref.erase(cp, n);
+            }
+        } else {
+            txt.optimize();
+        }
+        verify(step);
+    }
+    assert(txt.debug_verify_spans());
+    check_equal(encode_utf8(ref), txt, "utf8/final", 0, 31);
+
+    txt.assign(encode_utf8(ref));
+    verify(-1);
+    assert(txt.debug_verify_spans());
+
+    cout << "\u2713 UTF-8 mode test passed\n";
+}
+
+void test_seeded_levels() {
+    cout << "\n[SEED TEST] Same seed and edits give the same structure...\n";
+
+    auto build = [](uint64_t seed) {
+        BiModalText txt(seed);
+        mt19937 rng(41);
+        for (int i = 0; i < 3000; ++i) {
+            size_t pos = txt.size() == 0 ? 0 : rng() % (txt.size() + 1);
+            size_t len = (i % 100 == 0) ? NODE_MAX_SIZE * 3 : 1 + rng() % 64;  // 큰 붙여넣기는 노드 런을 만든다
+            txt.insert(pos, string(len, static_cast<char>('a' + rng() % 26)));
+        }
+        ostringstream os;
+        txt.debug_dump_structure(os);
+        return os.str();
+    };
+
+    assert(build(7) == build(7));
+    assert(build(7) != build(8));
+
+    cout << "\u2713 Seeded level test passed\n";
+}
+
+void test_adaptive_maintain() {
+    cout << "\n[MAINTAIN TEST] Read-hot nodes compact, the typing region stays Gap...\n";
+
+    string ref;
+    for (int i = 0; i < 200000; ++i) ref.push_back(static_cast<char>('a' + i % 26));
+    BiModalText txt(ref, 3);
+    assert(txt.debug_gap_node_count() == 0);
+
+    // 앞쪽 노드들은 한 번씩만 편집되고, 150000 근처는 계속 타이핑된다.
+    for (size_t k = 0; k < 20; ++k) {
+        txt.insert(k * 2000, "x");
+        ref.insert(k * 2000, "x");
+    }
+    for (size_t i = 0; i < 300; ++i) {
+        txt.insert(150000 + i, "y");
+        ref.insert(150000 + i, "y");
+    }
+    // 임의 접근 at() 과 (편집마다 도는) debug 검증은 읽기 카운터를 올리지 않으므로 아직 바꿀 노드가 없다.
+    for (size_t p = 0; p < ref.size(); p += 97) assert(txt.at(p) == ref[p]);
+    assert(txt.maintain(SIZE_MAX) == 0);
+
+    // 백그라운드 분석기의 전체 스캔
+    for (int r = 0; r < 16; ++r) {
+        size_t seen = 0;
+        txt.for_each_chunk(0, SIZE_MAX, [&](std::span<const char> c) { seen += c.size(); });
+        assert(seen == ref.size());
+    }
+
+    const size_t before = txt.debug_gap_node_count();
+    const size_t first = txt.maintain(1);    // 예산을 넘으면 노드 하나에서 멈춘다
+    assert(first > 0 && first <= NODE_MAX_SIZE);
+    assert(txt.debug_gap_node_count() == before - 1);
+
+    txt.maintain(SIZE_MAX);
+    const size_t after = txt.debug_gap_node_count();
+    assert(after >= 1 && after + 8 < before);
+    assert(txt.debug_verify_spans());
+    check_equal(ref, txt, "maintain/content", 0, 3);
+
+    cout << "\u2713 Adaptive maintain test passed (" << before << " -> " << after << " gap nodes)\n";
+}
+
+void test_optimize_step() {
+    cout << "\n[OPTIMIZE STEP TEST] Incremental optimize with edits between steps...\n";
+
+    BiModalText txt(11);
+    string ref;
+    mt19937 rng(19);
+    for (int i = 0; i < 4000; ++i) {
+        size_t pos = ref.empty() ? 0 : rng() % (ref.size() + 1);
+        string s((i % 200 == 0) ? NODE_MAX_SIZE * 4 : 1 + rng() % 48, static_cast<char>('a' + rng() % 26));
+        txt.insert(pos, s);
+        ref.insert(pos, s);
+        if (i % 3 == 0 && ref.size() > 64) {
+            size_t p = rng() % (ref.size() - 32);
+            txt.erase(p, 24);
+            ref.erase(p, 24);
+        }
+    }
+
+    // 편집 없이 나눠 돌리면 진행률이 단조 증가하고, 끝나면 모든 노드가 Compact 다.
+    size_t steps = 0;
+    size_t last = 0;
+    BiModalText::OptimizeProgress pr{};
+    do {
+        pr = txt.optimize_step(8192);
+        assert(pr.done || pr.position > last);
+        last = pr.position;
+        ++steps;
+    } while (!pr.done);
+    assert(steps > 1 && pr.fraction() == 1.0);
+    assert(txt.debug_gap_node_count() == 0);
+    assert(txt.debug_verify_spans());
+    check_equal(ref, txt, "optimize_step/clean", 0, 19);
+
+    // 스텝 사이에 편집이 끼어들어도 내용과 span 은 유지된다.
+    for (int round = 0; round < 300; ++round) {
+        size_t pos = rng() % (ref.size() + 1);
+        if (round % 2) {
+            txt.insert(pos, "step");
+            ref.insert(pos, "step");
+        } else if (pos + 100 < ref.size()) {
+            txt.erase(pos, 100);
+            ref.erase(pos, 100);
+        }
+        txt.optimize_step(1 + rng() % 20000, std::chrono::microseconds(50));
+        if (round % 50 == 0) {
+            assert(txt.debug_verify_spans());
+            check_equal(ref, txt, "optimize_step/edits", round, 19);
+        }
+    }
+    txt.optimize();
+    check_equal(ref, txt, "optimize_step/final", 0, 19);
+    // 편집으로 남은 gap 용량은 optimize() 후 노드 크기에 비례하는 만큼만 남는다.
+    assert(txt.debug_compact_slack() <= txt.size() / NodeData::COMPACT_SLACK_DIVISOR);
+
+    cout << "\u2713 Optimize step test passed (" << steps << " steps)\n";
+}
+
+void test_lazy_dirty_list() {
+    cout << "\n[LAZY DIRTY TEST] Lazy optimize visits only written nodes...\n";
+
+    // NODE_MAX_SIZE 노드 256 개: 작은 삭제는 분할 없이 노드 하나만 Gap 으로 만든다.
+    string ref(NODE_MAX_SIZE * 256, 'd');
+    BiModalText txt(ref, 13);
+    txt.set_lazy_compaction(true);
+    assert(txt.debug_dirty_node_count() == 0);
+
+    const size_t positions[] = {10, ref.size() / 2, ref.size() - 20};
+    for (size_t p : positions) {
+        txt.erase(p, 8);
+        ref.erase(p, 8);
+    }
+    assert(txt.debug_dirty_node_count() == 3);
+    txt.optimize();
+    assert(txt.debug_dirty_node_count() == 0);
+    assert(txt.debug_gap_node_count() == 3);   // 세 노드 모두 Pending
+    check_equal(ref, txt, "lazy-dirty/marked", 0, 13);
+
+    // 작은 노드가 생기면 병합을 위한 전체 패스로 넘어간다.
+    txt.erase(NODE_MAX_SIZE * 10 + 5, NODE_MAX_SIZE * 2 - 300);
+    ref.erase(NODE_MAX_SIZE * 10 + 5, NODE_MAX_SIZE * 2 - 300);
+    const size_t before = txt.debug_node_count();
+    txt.optimize();
+    assert(txt.debug_node_count() < before);
+    assert(txt.debug_dirty_node_count() == 0);
+    check_equal(ref, txt, "lazy-dirty/merge", 0, 13);
+
+    txt.set_lazy_compaction(false);
+    txt.optimize();
+    assert(txt.debug_gap_node_count() == 0);
+    check_equal(ref, txt, "lazy-dirty/compact", 0, 13);
+
+    cout << "\u2713 Lazy dirty list test passed\n";
+}
+
+void test_adaptive_gap() {
+    cout << "\n[ADAPTIVE GAP TEST] Gap reservation follows insert burst sizes...\n";
+
+    string ref(1 << 20, 'q');
+    BiModalText txt(ref, 5);
+    mt19937 rng(20);
+
+    // 문서 전체에 흩어진 짧은 편집: gap 은 MIN_GAP_SIZE 근처로 줄어야 한다.
+    for (int i = 0; i < 400; ++i) {
+        size_t pos = rng() % (ref.size() + 1);
+        string s(1 + rng() % 3, 'k');
+        txt.insert(pos, s);
+        ref.insert(pos, s);
+    }
+    const size_t nodes = txt.debug_gap_node_count();
+    const size_t slack = txt.debug_gap_slack();
+    assert(nodes > 100);
+    assert(slack < nodes * DEFAULT_GAP_SIZE / 4);   // inline 빌드는 힙 slack 이 0 이다
+    check_equal(ref, txt, "adaptive_gap/small", 0, 20);
+
+    // 붙여넣기가 잦아지면 새 gap 이 다시 커진다.
+    for (int i = 0; i < 200; ++i) {
+        size_t pos = rng() % (ref.size() + 1);
+        string s(1500 + rng() % 1500, 'P');
+        txt.insert(pos, s);
+        ref.insert(pos, s);
+    }
+    if constexpr (NODE_INLINE_CAPACITY == 0) {
+        assert(txt.debug_gap_slack() / txt.debug_gap_node_count() > DEFAULT_GAP_SIZE);
+    }
+    assert(txt.debug_verify_spans());
+    check_equal(ref, txt, "adaptive_gap/paste", 0, 20);
+
+    cout << "\u2713 Adaptive gap test passed (" << slack / nodes << " bytes of slack per gap node)\n";
+}
+
+void test_apply_edits() {
+    cout << "\n[BATCH EDIT TEST] apply_edits matches edits applied one by one...\n";
+
+    mt19937 rng(21);
+    string ref;
+    for (int i = 0; i < 300000; ++i) ref.push_back(static_cast<char>('a' + rng() % 26));
+    BiModalText txt(ref, 21);
+    vector<string> texts;   // Edit::text 가 가리키는 저장소
+
+    for (int round = 0; round < 40; ++round) {
+        // 원본 기준으로 겹치지 않는 편집들을 만든 뒤 순서를 섞어서 넘긴다.
+        vector<BiModalText::Edit> edits;
+        texts.clear();
+        texts.reserve(400);
+        size_t cursor = 0;
+        while (edits.size() < 300) {
+            cursor += rng() % (ref.size() / 250 + 1);
+            if (cursor > ref.size()) break;
+            size_t len = 0;
+            switch (rng() % 4) {
+                case 0: len = 0; break;
+                case 1: len = 1 + rng() % 16; break;
+                case 2: len = rng() % 12 == 0 ? 5000 + rng() % 5000 : 0; break;  // 노드 경계를 넘는 삭제
+                default: len = rng() % 4; break;
+            }
+            len = min(len, ref.size() - cursor);
+            size_t text_len = rng() % 5 == 0 ? (rng() % 8 == 0 ? 6000 : 200) : rng() % 6;
+            texts.emplace_back(text_len, static_cast<char>('A' + rng() % 26));
+            edits.push_back({cursor, len, texts.back()});
+            if (rng() % 4 == 0) {   // 같은 위치의 추가 삽입 (순서 유지)
+                texts.emplace_back(1 + rng() % 3, '#');
+                edits.push_back({cursor + len, 0, texts.back()});
+            }
+            cursor += len;
+        }
+        vector<BiModalText::Edit> shuffled = edits;
+        std::stable_sort(shuffled.begin(), shuffled.end(),
+                         [](const auto& a, const auto& b) { return a.pos < b.pos; });
+        // 같은 pos 의 상대 순서는 유지한 채 나머지는 섞는다: 뒤집어도 stable_sort 결과는 같아야 한다.
+        vector<BiModalText::Edit> reversed;
+        for (size_t i = shuffled.size(); i-- > 0;) {
+            size_t j = i;
+            while (j > 0 && shuffled[j - 1].pos == shuffled[i].pos) --j;
+            for (size_t k = j; k <= i; ++k) reversed.push_back(shuffled[k]);
+            i = j;
+        }
+
+        string expect;
+        size_t last = 0;
+        for (const auto& e : shuffled) {
+            expect.append(ref, last, e.pos - last);
+            expect.append(e.text);
+            last = e.pos + e.len;
+        }
+        expect.append(ref, last, string::npos);
+
+        txt.apply_edits(round % 2 ? std::span<const BiModalText::Edit>(reversed)
+                                  : std::span<const BiModalText::Edit>(shuffled));
+        ref = std::move(expect);
+        check_equal(ref, txt, "apply_edits/round", round, 21);
+        if (round % 10 == 9) txt.optimize();
+    }
+    assert(txt.debug_verify_spans());
+
+    // 겹치는 편집은 거부하고 문서를 건드리지 않는다.
+    vector<BiModalText::Edit> bad = {{10, 5, "x"}, {12, 1, "y"}};
+    bool thrown = false;
+    try {
+        txt.apply_edits(bad);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+    check_equal(ref, txt, "apply_edits/overlap", 0, 21);
+
+    // 같은 pos 의 삽입과 삭제는 넘긴 순서와 무관하게 삽입이 먼저 들어간다.
+    for (int flip = 0; flip < 2; ++flip) {
+        vector<BiModalText::Edit> same_pos = {{0, 5, ""}, {0, 0, "x"}, {7, 2, "yy"}, {7, 0, "z"}};
+        if (flip) std::reverse(same_pos.begin(), same_pos.end());
+        txt.apply_edits(same_pos);
+        ref = "x" + ref.substr(5, 2) + "z" + "yy" + ref.substr(9);
+        check_equal(ref, txt, "apply_edits/same_pos", flip, 21);
+    }
+
+    // 빈 배치와 no-op 뿐인 배치는 문서를 건드리지 않는다.
+    txt.apply_edits({});
+    vector<BiModalText::Edit> noop = {{3, 0, ""}, {ref.size(), 0, ""}};
+    txt.apply_edits(noop);
+    check_equal(ref, txt, "apply_edits/noop", 0, 21);
+    assert(txt.debug_verify_spans());
+
+    cout << "\u2713 Batch edit test passed\n";
+}
+
+void test_multi_cursor() {
+    cout << "\n[MULTI CURSOR TEST] One sweep per keystroke across many cursors...\n";
+
+    mt19937 rng(22);
+    string ref;
+    for (int i = 0; i < 200000; ++i) ref.push_back(static_cast<char>('a' + rng() % 26));
+    BiModalText txt(ref, 22);
+    BiModalText::MultiCursor mc = txt.multi_cursor();
+    vector<size_t> pos;
+    for (int i = 0; i < 300; ++i) {
+        size_t p = rng() % (ref.size() + 1);
+        mc.add(p);
+        pos.push_back(p);
+    }
+    mc.add(ref.size());   // 문서 끝 커서
+    pos.push_back(ref.size());
+    sort(pos.begin(), pos.end());
+    pos.erase(unique(pos.begin(), pos.end()), pos.end());
+    assert(mc.positions() == pos);
+
+    auto dedupe = [&]() { pos.erase(unique(pos.begin(), pos.end()), pos.end()); };
+    for (int step = 0; step < 400; ++step) {
+        int op = rng() % 10;
+        if (op <= 4) {
+            string s(1 + rng() % 3, static_cast<char>('A' + rng() % 26));
+            mc.insert_here(s);
+            for (size_t i = pos.size(); i-- > 0;) ref.insert(pos[i], s);
+            for (size_t i = 0; i < pos.size(); ++i) pos[i] += (i + 1) * s.size();
+        } else if (op <= 6) {
+            size_t n = 1 + rng() % 4;
+            mc.erase_before(n);
+            vector<size_t> from(pos.size());
+            for (size_t i = 0; i < pos.size(); ++i) {
+                size_t lo = i ? pos[i - 1] : 0;
+                from[i] = pos[i] >= lo + n ? pos[i] - n : lo;
+            }
+            for (size_t i = pos.size(); i-- > 0;) ref.erase(from[i], pos[i] - from[i]);
+            size_t removed = 0;
+            for (size_t i = 0; i < pos.size(); ++i) {
+                size_t len = pos[i] - from[i];
+                pos[i] = from[i] - removed;
+                removed += len;
+            }
+            dedupe();
+        } else if (op <= 8) {
+            size_t n = 1 + rng() % 4;
+            mc.erase_here(n);
+            vector<size_t> len(pos.size());
+            for (size_t i = 0; i < pos.size(); ++i) {
+                size_t hi = i + 1 < pos.size() ? pos[i + 1] : ref.size();
+                len[i] = min(n, hi - pos[i]);
+            }
+            for (size_t i = pos.size(); i-- > 0;) ref.erase(pos[i], len[i]);
+            size_t removed = 0;
+            for (size_t i = 0; i < pos.size(); ++i) {
+                pos[i] -= removed;
+                removed += len[i];
+            }
+            dedupe();
+        } else {
+            long delta = static_cast<long>(rng() % 9) - 4;
+            mc.move_by(delta);
+            for (size_t& p : pos) p = static_cast<size_t>(min<long>(max<long>(0, static_cast<long>(p) + delta),
+                                                                    static_cast<long>(ref.size())));
+            dedupe();
+        }
+        if (mc.positions() != pos) {
+            cerr << "[FAIL] multi cursor positions mismatch step=" << step << "\n";
+            std::exit(1);
+        }
+        if (step % 50 == 0) check_equal(ref, txt, "multi_cursor/step", step, 22);
+    }
+    assert(txt.debug_verify_spans());
+    check_equal(ref, txt, "multi_cursor/final", 0, 22);
+
+    cout << "\u2713 Multi cursor test passed (" << pos.size() << " cursors)\n";
+}
+
+void test_snapshot() {
+    cout << "\n[SNAPSHOT TEST] Copy-on-write snapshots stay stable while editing...\n";
+
+    mt19937 rng(23);
+    string ref;
+    for (int i = 0; i < 100000; ++i) ref.push_back(static_cast<char>('a' + rng() % 26));
+    vector<pair<BiModalText::Snapshot, string>> taken;
+    {
+        BiModalText txt(ref, 23);
+        for (int step = 0; step < 3000; ++step) {
+            int op = rng() % 12;
+            size_t pos = rng() % (ref.size() + 1);
+            if (op <= 4) {
+                string s((step % 500 == 0) ? NODE_MAX_SIZE * 2 : 1 + rng() % 40, static_cast<char>('A' + rng() % 26));
+                txt.insert(pos, s);
+                ref.insert(pos, s);
+            } else if (op <= 7) {
+                size_t len = min<size_t>(1 + rng() % 300, ref.size() - min(pos, ref.size()));
+                txt.erase(pos, len);
+                ref.erase(min(pos, ref.size()), len);
+            } else if (op == 8) {
+                txt.optimize();
+            } else if (op == 9) {
+                txt.maintain(1 + rng() % 20000);
+            } else if (op == 10) {
+                // 커서의 노드 내부 경로도 바뀐 구간을 남긴다.
+                BiModalText::Cursor cur(txt, min(pos, ref.size()));
+                for (int k = 0; k < 5; ++k) {
+                    cur.insert_here("c");
+                    ref.insert(cur.position() - 1, "c");
+                }
+                if (cur.position() < ref.size()) {
+                    cur.erase_here(3);
+                    ref.erase(cur.position(), 3);
+                }
+            } else {
+                // 배치 편집의 노드 내부 경로
+                vector<BiModalText::Edit> edits;
+                size_t p = rng() % 200;
+                while (p + 20 < ref.size() && edits.size() < 8) {
+                    edits.push_back({p, rng() % 6, "xy"});
+                    p += 20 + rng() % 4000;
+                }
+                txt.apply_edits(edits);
+                for (size_t k = edits.size(); k-- > 0;) ref.replace(edits[k].pos, edits[k].len, edits[k].text);
+            }
+            if (step % 10 == 0 && txt.snapshot().to_string() != ref) {
+                // 바뀐 구간만 갈아 끼운 기준 트리가 현재 내용과 같아야 한다.
+                cerr << "[FAIL] incremental snapshot differs from live text at step " << step << "\n";
+                std::exit(1);
+            }
+            if (step % 150 == 0) {
+                BiModalText::Snapshot snap = txt.snapshot();
+                BiModalText::Snapshot again = txt.snapshot();   // 편집이 없으면 같은 스냅숏
+                assert(again.size() == snap.size());
+                taken.emplace_back(snap, ref);
+            }
+            if (step % 300 == 0 && taken.size() > 4) taken.erase(taken.begin() + 1);   // 일부는 중간에 놓는다
+            if (step % 100 == 0) check_equal(ref, txt, "snapshot/live", step, 23);
+        }
+        for (const auto& [snap, expect] : taken) {
+            if (snap.to_string() != expect) {
+                cerr << "[FAIL] snapshot content changed under edits\n";
+                std::exit(1);
+            }
+        }
+        assert(txt.debug_verify_spans());
+    }
+    // 문서가 사라진 뒤에도 스냅숏은 유효하다.
+    for (const auto& [snap, expect] : taken) {
+        assert(snap.size() == expect.size());
+        for (int k = 0; k < 200 && !expect.empty(); ++k) {
+            size_t p = rng() % expect.size();
+            assert(snap.at(p) == expect[p]);
+        }
+        size_t p = expect.size() / 3;
+        string part;
+        snap.for_each_chunk(p, 5000, [&](std::span<const char> c) { part.append(c.data(), c.size()); });
+        assert(part == expect.substr(p, 5000));
+    }
+
+    // 큰 문서에서 작은 편집 뒤의 snapshot() 은 바뀐 노드와 트리 경로만 새로 만든다. (전체면 노드 수만큼)
+    {
+        constexpr size_t NODES = 2048;
+        BiModalText big(string(NODE_MAX_SIZE * NODES, 'b'), 23);
+        BiModalText::Snapshot first = big.snapshot();
+        for (int k = 0; k < 20; ++k) {
+            big.insert(rng() % big.size(), "snap");
+            const size_t before = PieceTree::debug_nodes_created();
+            BiModalText::Snapshot snap = big.snapshot();
+            assert(PieceTree::debug_nodes_created() - before < NODES / 8);
+            assert(snap.size() == big.size());
+        }
+        assert(first.to_string() == string(NODE_MAX_SIZE * NODES, 'b'));
+    }
+
+    cout << "\u2713 Snapshot test passed (" << taken.size() << " snapshots)\n";
+}
+
+void test_versions() {
+    cout << "\n[VERSION TEST] commit/undo/redo/checkout over shared payloads...\n";
+
+    mt19937 rng(24);
+    string ref;
+    for (int i = 0; i < 50000; ++i) ref.push_back(static_cast<char>('a' + rng() % 26));
+    BiModalText txt(ref, 24);
+    vector<string> states = {ref};   // states[i] == i 번째 commit 의 내용 (history 와 같은 모양으로 관리)
+    size_t at = 0;
+    txt.commit();
+
+    for (int step = 0; step < 600; ++step) {
+        int op = rng() % 10;
+        if (op <= 5) {
+            // 편집 그룹 하나 (가끔 큰 붙여넣기)
+            for (int k = 0; k < 1 + static_cast<int>(rng() % 4); ++k) {
+                size_t pos = rng() % (ref.size() + 1);
+                if (rng() % 3) {
+                    string s(step % 97 == 0 ? NODE_MAX_SIZE * 8 : 1 + rng() % 30, static_cast<char>('A' + rng() % 26));
+                    txt.insert(pos, s);
+                    ref.insert(pos, s);
+                } else if (pos < ref.size()) {
+                    size_t len = min<size_t>(1 + rng() % 500, ref.size() - pos);
+                    txt.erase(pos, len);
+                    ref.erase(pos, len);
+                }
+            }
+            if (rng() % 4) {
+                txt.commit();
+                states.resize(at + 1);
+                states.push_back(ref);
+                at = states.size() - 1;
+            }
+        } else if (op <= 7) {
+            bool dirty = txt.to_string() != states[at];
+            bool ok = txt.undo();
+            if (dirty) {
+                assert(ok);
+            } else {
+                assert(ok == (at > 0));
+                if (ok) --at;
+            }
+            ref = states[at];
+        } else if (op == 8) {
+            bool ok = txt.redo();
+            if (ok) {
+                ++at;
+                ref = states[at];
+            }
+        } else {
+            txt.optimize();
+        }
+        if (step % 25 == 0 || op >= 6) check_equal(ref, txt, "versions/step", step, 24);
+    }
+    assert(txt.debug_verify_spans());
+
+    // 임의 버전 checkout: 현재와 무관한 버전으로 갔다가 편집해도 원래 버전은 그대로다.
+    BiModalText::Version v = txt.commit();
+    const string saved = txt.to_string();
+    txt.insert(0, string(NODE_MAX_SIZE * 4, 'Z'));
+    txt.erase(txt.size() / 2, 1000);
+    txt.checkout(v);
+    check_equal(saved, txt, "versions/checkout", 0, 24);
+    txt.insert(txt.size() / 3, "edit after checkout");
+    assert(v.to_string() == saved);
+
+    cout << "\u2713 Version test passed (" << states.size() << " versions)\n";
+}
+
+void test_version_sharing() {
+    cout << "\n[VERSION SHARING TEST] Small edits on a large document share structure between versions...\n";
+
+    constexpr size_t NODES = 2048;
+    mt19937 rng(26);
+    string ref(NODE_MAX_SIZE * NODES, ' ');
+    for (char& c : ref) c = static_cast<char>('a' + rng() % 26);
+    BiModalText txt(ref, 26);
+    txt.commit();   // 첫 버전만 모든 노드를 얼린다
+
+    for (int round = 0; round < 20; ++round) {
+        const size_t pos = rng() % ref.size();
+        const string s = "edit" + std::to_string(round);
+        txt.insert(pos, s);
+
+        // 버전 하나가 새로 만드는 트리 노드는 바뀐 노드의 piece 와 O(log n) 경로뿐이다. (전체 복사면 NODES 개 이상)
+        const size_t tree_before = PieceTree::debug_nodes_created();
+        txt.commit();
+        assert(PieceTree::debug_nodes_created() - tree_before < NODES / 8);
+
+        // undo/redo 는 바뀐 구간의 노드만 다시 연결한다.
+        size_t nodes_before = txt.debug_created_nodes();
+        assert(txt.undo());
+        assert(txt.debug_created_nodes() - nodes_before <= 4);
+        assert(txt.size() == ref.size());
+        assert(txt.substr(pos, 64) == ref.substr(pos, 64));
+
+        nodes_before = txt.debug_created_nodes();
+        assert(txt.redo());
+        assert(txt.debug_created_nodes() - nodes_before <= 4);
+        ref.insert(pos, s);
+        assert(txt.substr(pos > 32 ? pos - 32 : 0, 96) == ref.substr(pos > 32 ? pos - 32 : 0, 96));
+    }
+    assert(txt.debug_verify_spans());
+    check_equal(ref, txt, "version_sharing/edits", 0, 26);
+
+    // 큰 붙여넣기: undo 는 붙여넣은 구간을 지우기만 하고, redo 는 붙여넣은 노드 수만큼만 연결한다.
+    constexpr size_t PASTE_NODES = 64;
+    const size_t pos = ref.size() / 2;
+    txt.insert(pos, string(NODE_MAX_SIZE * PASTE_NODES, 'P'));
+    txt.commit();
+    size_t nodes_before = txt.debug_created_nodes();
+    assert(txt.undo());
+    assert(txt.debug_created_nodes() - nodes_before <= 4);
+    check_equal(ref, txt, "version_sharing/undo_paste", 0, 26);
+    nodes_before = txt.debug_created_nodes();
+    assert(txt.redo());
+    assert(txt.debug_created_nodes() - nodes_before <= PASTE_NODES + 4);
+    ref.insert(pos, string(NODE_MAX_SIZE * PASTE_NODES, 'P'));
+    check_equal(ref, txt, "version_sharing/redo_paste", 0, 26);
+
+    cout << "\u2713 Version sharing test passed\n";
+}
+
+// Reader::read() 는 공개본을 가리키는 참조를 돌려주는 func 를 받지 않는다.
+template <typename Func>
+concept ReaderCallable = requires(const BiModalText::Reader& r, Func f) { r.read(f); };
+
+void test_concurrent_readers() {
+    cout << "\n[CONCURRENCY TEST] Readers see whole published versions while the writer edits...\n";
+
+    constexpr int STEPS = 300;
+    mt19937 rng(25);
+    string ref = "v0\n";
+    for (int i = 0; i < 60000; ++i) ref.push_back(static_cast<char>('a' + rng() % 26));
+    BiModalText txt(ref, 25);
+    vector<size_t> expected(STEPS + 1);   // 공개 전에 써 두고, publish() 의 원자적 교체로 읽기 쪽에 전달된다
+    expected[0] = std::hash<string>{}(ref);
+    txt.publish();
+
+    std::atomic<bool> done{false};
+    std::atomic<int> failures{0};
+    std::atomic<long> reads{0};
+    vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&, t]() {
+            BiModalText::Reader reader(txt);
+            mt19937 local(100 + t);
+            while (!done.load()) {
+                reader.read([&](const BiModalText::Snapshot& snap) {
+                    const string content = snap.to_string();
+                    const size_t k = std::stoul(content.substr(1, content.find('\n') - 1));
+                    if (std::hash<string>{}(content) != expected[k]) ++failures;
+                    for (int q = 0; q < 50; ++q) {
+                        size_t p = local() % content.size();
+                        if (snap.at(p) != content[p]) ++failures;
+                    }
+                });
+                ++reads;
+            }
+        });
+    }
+
+    for (int k = 1; k <= STEPS; ++k) {
+        for (int e = 0; e < 5; ++e) {
+            size_t pos = 8 + rng() % (ref.size() - 8);
+            if (rng() % 2) {
+                string s(1 + rng() % 40, static_cast<char>('A' + rng() % 26));
+                txt.insert(pos, s);
+                ref.insert(pos, s);
+            } else {
+                size_t len = min<size_t>(1 + rng() % 40, ref.size() - pos);
+                txt.erase(pos, len);
+                ref.erase(pos, len);
+            }
+        }
+        const size_t header = ref.find('\n') + 1;
+        const string next = "v" + std::to_string(k) + "\n";
+        txt.erase(0, header);
+        txt.insert(0, next);
+        ref.replace(0, header, next);
+        if (k % 50 == 0) txt.optimize();
+        expected[k] = std::hash<string>{}(ref);
+        txt.publish();
+        std::this_thread::yield();
+    }
+    done.store(true);
+    for (auto& th : readers) th.join();
+
+    assert(failures.load() == 0);
+    assert(reads.load() > 0);
+    assert(txt.reclaim() == 0);   // 읽기가 모두 끝났으므로 이전 공개본은 전부 회수된다
+    check_equal(ref, txt, "concurrent/final", 0, 25);
+
+    // 중첩 읽기: 안쪽 read() 가 끝나도 바깥 읽기의 공개본은 회수되지 않는다.
+    {
+        BiModalText::Reader reader(txt);
+        reader.read([&](const BiModalText::Snapshot& outer) {
+            const size_t inner = reader.read([](const BiModalText::Snapshot& s) { return s.size(); });
+            assert(inner == outer.size());
+            txt.insert(0, "nested\n");
+            txt.publish();
+            txt.publish();
+            assert(txt.reclaim() > 0);   // 바깥 읽기가 아직 epoch 를 잡고 있다
+            assert(outer.to_string() == ref);
+            return 0;
+        });
+        assert(txt.reclaim() == 0);
+    }
+    auto by_value = [](const BiModalText::Snapshot& s) { return s.size(); };
+    auto by_reference = [](const BiModalText::Snapshot& s) -> const BiModalText::Snapshot& { return s; };
+    static_assert(ReaderCallable<decltype(by_value)>);
+    static_assert(!ReaderCallable<decltype(by_reference)>);
+
+    cout << "\u2713 Concurrent reader test passed (" << reads.load() << " reads)\n";
+}
+
 void run_boundary_tests() {
     cout << "\n[BOUNDARY] Running targeted structural tests...\n";
     test_split_boundary();
     test_erase_across_nodes();
     test_optimize_with_tiny_nodes();
+    test_bulk_load();
+    test_large_paste();
+    test_defragment();
+    test_eager_rebalance();
+    test_finger_locality();
+    test_line_index();
+    test_utf8_mode();
+    test_seeded_levels();
+    test_adaptive_maintain();
+    test_optimize_step();
+    test_lazy_dirty_list();
+    test_adaptive_gap();
+    test_apply_edits();
+    test_multi_cursor();
+    test_snapshot();
+    test_versions();
+    test_version_sharing();
+    test_concurrent_readers();
 }
 
 // -----------------------------------------------------------------------------